@@ -26,6 +26,17 @@ int overlap_code(
 
 int invert_overlap_code(int code);
 
+void pcompare_ranges(
+	const int *x_start,
+	const int *x_width,
+	int x_len,
+	const int *y_start,
+	const int *y_width,
+	int y_len,
+	int *out,
+	int out_len
+);
+
 /*
  * Low-level manipulation of IRanges objects.
  * (see IRanges_class.c)
@@ -65,6 +76,8 @@ SEXP new_list_of_IRanges_from_IntPairAEAE(const char *element_type, const IntPai
 
 SEXP alloc_IRanges(const char *classname, int length);
 
+SEXP new_IRanges_from_external_buffers(const char *classname, const int *start, const int *width, int length, int writable, SEXP owner);
+
 /*
  * Low-level manipulation of Grouping objects.
  * (see Grouping_class.c)
@@ -41,6 +41,11 @@ DEFINE_CCALLABLE_STUB(int, invert_overlap_code,
 	(    code)
 )
 
+DEFINE_NOVALUE_CCALLABLE_STUB(pcompare_ranges,
+	(const int *x_start, const int *x_width, int x_len, const int *y_start, const int *y_width, int y_len, int *out, int out_len),
+	(           x_start,            x_width,     x_len,            y_start,            y_width,     y_len,      out,     out_len)
+)
+
 /*
  * Stubs for callables defined in IRanges_class.c
  */
@@ -130,6 +135,11 @@ DEFINE_CCALLABLE_STUB(SEXP, alloc_IRanges,
 	(            classname,     length)
 )
 
+DEFINE_CCALLABLE_STUB(SEXP, new_IRanges_from_external_buffers,
+	(const char *classname, const int *start, const int *width, int length, int writable, SEXP owner),
+	(            classname,            start,            width,     length,     writable,      owner)
+)
+
 /*
  * Stubs for callables defined in Grouping_class.c
  */
@@ -0,0 +1,63 @@
+/****************************************************************************
+ * Helper for test_IRanges_over_external_buffers() in test_IRanges-class.R.
+ * It is compiled with 'R CMD SHLIB' when the test runs, and creates the
+ * objects thru the new_IRanges_from_external_buffers() C callable, like
+ * a package that has IRanges in its LinkingTo field would do.
+ ****************************************************************************/
+#include "_IRanges_stubs.c"
+#include <R_ext/Altrep.h>
+
+#include <stdlib.h>  /* for malloc() and free() */
+#include <string.h>  /* for memcpy() */
+
+static void free_buffer(SEXP xp)
+{
+	void *buf;
+
+	buf = R_ExternalPtrAddr(xp);
+	if (buf != NULL) {
+		free(buf);
+		R_ClearExternalPtr(xp);
+	}
+	return;
+}
+
+/* --- .Call ENTRY POINT ---
+ * Copies 'start' and 'width' to a malloc'ed buffer that is released when
+ * the returned IRanges object gets garbage collected, and uses it as the
+ * external memory of the object.
+ */
+SEXP new_IRanges_over_malloced_buffer(SEXP start, SEXP width, SEXP writable)
+{
+	int n;
+	int *buf;
+	SEXP owner, ans;
+
+	n = LENGTH(start);
+	buf = (int *) malloc(sizeof(int) * (2 * (size_t) n + 1));
+	if (buf == NULL)
+		error("new_IRanges_over_malloced_buffer(): malloc() failed");
+	memcpy(buf, INTEGER(start), sizeof(int) * n);
+	memcpy(buf + n, INTEGER(width), sizeof(int) * n);
+	PROTECT(owner = R_MakeExternalPtr(buf, R_NilValue, R_NilValue));
+	R_RegisterCFinalizerEx(owner, free_buffer, TRUE);
+	PROTECT(ans = new_IRanges_from_external_buffers("IRanges",
+			buf, buf + n, n, LOGICAL(writable)[0], owner));
+	UNPROTECT(2);
+	return ans;
+}
+
+/* --- .Call ENTRY POINT ---
+ * If 'write_access' is TRUE, requests write access to the data of 'x' (as
+ * INTEGER() does). Then returns TRUE if 'x' is now backed by a private
+ * copy of its external buffer, FALSE if it still points at the external
+ * buffer, and NA if 'x' is not an ALTREP vector.
+ */
+SEXP extbuf_is_copied(SEXP x, SEXP write_access)
+{
+	if (!ALTREP(x))
+		return ScalarLogical(NA_LOGICAL);
+	if (LOGICAL(write_access)[0])
+		INTEGER(x);
+	return ScalarLogical(R_altrep_data2(x) != R_NilValue);
+}
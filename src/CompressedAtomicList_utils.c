@@ -6,30 +6,50 @@
 
 #define R_INT_MIN	(1+INT_MIN)
 
-#define PARTITIONED_AGG(C_TYPE, ACCESSOR, ANS_TYPE, ANS_ACCESSOR,           \
+/* The data is scanned for NAs once before aggregating. When there are none
+   (the common case), the inner loop has no NA check and no 'na_rm' branch
+   so the compiler can vectorize it (e.g. sum/min/max of integers). The
+   elements are still visited in the same order so the results are the
+   same as with the NA-checking loop. */
+#define PARTITIONED_AGG(DATA_TYPE, C_TYPE, ACCESSOR, ANS_TYPE, ANS_ACCESSOR, \
 			NA_CHECK, INIT, UPDATE, EXTRA_INIT)                 \
 {                                                                           \
 	SEXP unlistData = _get_CompressedList_unlistData(x);                \
 	SEXP partitioning = _get_CompressedList_partitioning(x);            \
 	SEXP ends = _get_PartitioningByEnd_end(partitioning);               \
 	Rboolean _na_rm = asLogical(na_rm);                                 \
-	int prev_end = 0;                                                   \
-	SEXP ans = allocVector(ANS_TYPE, length(ends));                     \
-	for (int i = 0; i < length(ends); i++) {                            \
-		int end = INTEGER(ends)[i];                                 \
+	int nends = LENGTH(ends), data_len = LENGTH(unlistData);            \
+	const int *ends_p = INTEGER(ends);                                  \
+	const DATA_TYPE *data = ACCESSOR(unlistData);                       \
+	int prev_end = 0, has_na = 0;                                       \
+	for (int j = 0; j < data_len; j++) {                                \
+		DATA_TYPE val = data[j];                                    \
+		if (NA_CHECK) {                                             \
+			has_na = 1;                                         \
+			break;                                              \
+		}                                                           \
+	}                                                                   \
+	SEXP ans = allocVector(ANS_TYPE, nends);                            \
+	for (int i = 0; i < nends; i++) {                                   \
+		int end = ends_p[i];                                        \
 		C_TYPE summary = INIT;                                      \
 		EXTRA_INIT;                                                 \
-		for (int j = prev_end; j < end; j++) {                      \
-			C_TYPE val = ACCESSOR(unlistData)[j];               \
-			if (NA_CHECK) {                                     \
-				if (_na_rm) {                               \
-					continue;                           \
-				} else {                                    \
+		if (!has_na) {                                              \
+			for (int j = prev_end; j < end; j++) {              \
+				DATA_TYPE val = data[j];                    \
+				UPDATE;                                     \
+			}                                                   \
+		} else {                                                    \
+			for (int j = prev_end; j < end; j++) {              \
+				DATA_TYPE val = data[j];                    \
+				if (NA_CHECK) {                             \
+					if (_na_rm)                         \
+						continue;                   \
 					summary = NA_ ## ANS_ACCESSOR;      \
 					break;                              \
 				}                                           \
+				UPDATE;                                     \
 			}                                                   \
-			UPDATE;                                             \
 		}                                                           \
 		ANS_ACCESSOR(ans)[i] = summary;                             \
 		prev_end = end;                                             \
@@ -40,20 +60,20 @@
 
 #define PARTITIONED_SUM(C_TYPE, ACCESSOR, ANS_TYPE, ANS_ACCESSOR, NA_CHECK) \
 {                                                                           \
-	PARTITIONED_AGG(C_TYPE, ACCESSOR, ANS_TYPE, ANS_ACCESSOR,           \
+	PARTITIONED_AGG(C_TYPE, C_TYPE, ACCESSOR, ANS_TYPE, ANS_ACCESSOR,   \
 		NA_CHECK, 0, summary += val, );                             \
 }
 
-#define PARTITIONED_PROD(ACCESSOR, NA_CHECK)                                \
+#define PARTITIONED_PROD(DATA_TYPE, ACCESSOR, NA_CHECK)                     \
 {                                                                           \
-	PARTITIONED_AGG(double, ACCESSOR, REALSXP, REAL,                    \
+	PARTITIONED_AGG(DATA_TYPE, double, ACCESSOR, REALSXP, REAL,         \
 		NA_CHECK, 1, summary *= val, );                             \
 }
 
 /* --- .Call ENTRY POINT --- */
 SEXP C_sum_CompressedLogicalList(SEXP x, SEXP na_rm)
 {
-	PARTITIONED_SUM(Rboolean, LOGICAL, INTSXP, INTEGER, val == NA_LOGICAL);
+	PARTITIONED_SUM(int, LOGICAL, INTSXP, INTEGER, val == NA_LOGICAL);
 }
 
 /* --- .Call ENTRY POINT --- */
@@ -71,27 +91,27 @@ SEXP C_sum_CompressedNumericList(SEXP x, SEXP na_rm)
 /* --- .Call ENTRY POINT --- */
 SEXP C_prod_CompressedLogicalList(SEXP x, SEXP na_rm)
 {
-	PARTITIONED_PROD(LOGICAL, val == NA_LOGICAL);
+	PARTITIONED_PROD(int, LOGICAL, val == NA_LOGICAL);
 }
 
 /* --- .Call ENTRY POINT --- */
 SEXP C_prod_CompressedIntegerList(SEXP x, SEXP na_rm)
 {
-	PARTITIONED_PROD(INTEGER, val == NA_INTEGER);
+	PARTITIONED_PROD(int, INTEGER, val == NA_INTEGER);
 }
 
 /* --- .Call ENTRY POINT --- */
 SEXP C_prod_CompressedNumericList(SEXP x, SEXP na_rm)
 {
-	PARTITIONED_PROD(REAL, ISNA(val));
+	PARTITIONED_PROD(double, REAL, ISNA(val));
 }
 
 
 #define PARTITIONED_EX(C_TYPE, ACCESSOR, ANS_TYPE, NA_CHECK, INIT, RELOP)   \
 {                                                                           \
-	PARTITIONED_AGG(C_TYPE, ACCESSOR, ANS_TYPE, ACCESSOR,               \
+	PARTITIONED_AGG(C_TYPE, C_TYPE, ACCESSOR, ANS_TYPE, ACCESSOR,       \
 		NA_CHECK, INIT,                                             \
-		if (val RELOP summary) summary = val, );                    \
+		summary = val RELOP summary ? val : summary, );             \
 }
 
 #define PARTITIONED_MIN(C_TYPE, ACCESSOR, ANS_TYPE, NA_CHECK, INIT)         \
@@ -104,10 +124,22 @@ SEXP C_prod_CompressedNumericList(SEXP x, SEXP na_rm)
 	PARTITIONED_EX(C_TYPE, ACCESSOR, ANS_TYPE, NA_CHECK, INIT, >);      \
 }
 
+/* Like base::min() and base::max() on a double vector: with na.rm=FALSE,
+   an NA anywhere in the list element gives NA, otherwise a NaN gives NaN
+   (NA trumps NaN). With na.rm=TRUE, both are removed. */
+#define DOUBLE_NA_CHECK (_na_rm ? ISNAN(val) : ISNA(val))
+
+#define PARTITIONED_DOUBLE_EX(INIT, RELOP)                                  \
+{                                                                           \
+	PARTITIONED_AGG(double, double, REAL, REALSXP, REAL,                \
+		DOUBLE_NA_CHECK, INIT,                                      \
+		summary = ISNAN(val) || val RELOP summary ? val : summary, ); \
+}
+
 /* --- .Call ENTRY POINT --- */
 SEXP C_min_CompressedLogicalList(SEXP x, SEXP na_rm)
 {
-	PARTITIONED_MIN(Rboolean, LOGICAL, LGLSXP, val == NA_LOGICAL, TRUE);
+	PARTITIONED_MIN(int, LOGICAL, LGLSXP, val == NA_LOGICAL, TRUE);
 }
 
 /* --- .Call ENTRY POINT --- */
@@ -119,13 +151,13 @@ SEXP C_min_CompressedIntegerList(SEXP x, SEXP na_rm)
 /* --- .Call ENTRY POINT --- */
 SEXP C_min_CompressedNumericList(SEXP x, SEXP na_rm)
 {
-	PARTITIONED_MIN(double, REAL, REALSXP, ISNA(val), R_PosInf);
+	PARTITIONED_DOUBLE_EX(R_PosInf, <);
 }
 
 /* --- .Call ENTRY POINT --- */
 SEXP C_max_CompressedLogicalList(SEXP x, SEXP na_rm)
 {
-	PARTITIONED_MAX(Rboolean, LOGICAL, LGLSXP, val == NA_LOGICAL, TRUE);
+	PARTITIONED_MAX(int, LOGICAL, LGLSXP, val == NA_LOGICAL, FALSE);
 }
 
 /* --- .Call ENTRY POINT --- */
@@ -137,126 +169,1780 @@ SEXP C_max_CompressedIntegerList(SEXP x, SEXP na_rm)
 /* --- .Call ENTRY POINT --- */
 SEXP C_max_CompressedNumericList(SEXP x, SEXP na_rm)
 {
-	PARTITIONED_MAX(double, REAL, REALSXP, ISNA(val), R_NegInf);
+	PARTITIONED_DOUBLE_EX(R_NegInf, >);
 }
 
 
-#define PARTITIONED_WHICH_AGG(C_TYPE, ACCESSOR, NA_CHECK, INIT, RELOP)      \
-{                                                                           \
-	SEXP na_rm = ScalarLogical(TRUE);                                   \
-	PARTITIONED_AGG(int, ACCESSOR, INTSXP, INTEGER,                     \
-		NA_CHECK, NA_INTEGER,                                       \
-		if (val RELOP summary_val)                                  \
-			(summary_val = val, summary = j - prev_end + 1),    \
-		C_TYPE summary_val = INIT)                                  \
-}
+/* The which.min(), which.max(), range_with_which() and is.unsorted()
+   kernels below first check each list element for NAs (and NaNs). When
+   there are none, the element is scanned with loops that have no NA check
+   and no data-dependent exit: a min/max reduction followed by a scan that
+   locates the first occurrence of the result, or a comparison of each
+   value with its predecessor folded over blocks of values. The compiler can
+   vectorize these loops. Otherwise a scalar loop skipping the NAs is
+   used. */
+
+#define INT_IS_NA(v) ((v) == NA_INTEGER)
+
+#define SORTEDNESS_BLOCK	256
 
-#define PARTITIONED_WHICH_MIN(C_TYPE, ACCESSOR, NA_CHECK, INIT)             \
+/* Sets 'which_min' and 'which_max' to the 1-based indices of the first
+   min and first max of the non-NA values in 'x[0..n-1]' (NA_INTEGER if
+   there are none), and 'min' and 'max' to these values. Returns 1 if
+   'x[0..n-1]' contains NAs, 0 otherwise. */
+#define DEFINE_RANGE_WITH_WHICH_FUN(NAME, C_TYPE, IS_NA)                    \
+static int NAME(const C_TYPE *x, int n,                                     \
+		int *which_min, int *which_max, C_TYPE *min, C_TYPE *max)   \
 {                                                                           \
-	PARTITIONED_WHICH_AGG(C_TYPE, ACCESSOR, NA_CHECK, INIT, <)          \
+	int j, has_NA;                                                      \
+	C_TYPE mn, mx;                                                      \
+                                                                            \
+	*which_min = *which_max = NA_INTEGER;                               \
+	has_NA = 0;                                                         \
+	for (j = 0; j < n; j++)                                             \
+		has_NA |= IS_NA(x[j]);                                      \
+	if (!has_NA) {                                                      \
+		if (n == 0)                                                 \
+			return 0;                                           \
+		mn = mx = x[0];                                             \
+		for (j = 1; j < n; j++) {                                   \
+			mn = x[j] < mn ? x[j] : mn;                         \
+			mx = x[j] > mx ? x[j] : mx;                         \
+		}                                                           \
+		for (j = 0; x[j] != mn; j++) {}                             \
+		*which_min = j + 1;                                         \
+		for (j = 0; x[j] != mx; j++) {}                             \
+		*which_max = j + 1;                                         \
+		*min = mn;                                                  \
+		*max = mx;                                                  \
+		return 0;                                                   \
+	}                                                                   \
+	for (j = 0; j < n; j++) {                                           \
+		if (IS_NA(x[j]))                                            \
+			continue;                                           \
+		if (*which_min == NA_INTEGER) {                             \
+			*min = *max = x[j];                                 \
+			*which_min = *which_max = j + 1;                    \
+			continue;                                           \
+		}                                                           \
+		if (x[j] < *min) {                                          \
+			*min = x[j];                                        \
+			*which_min = j + 1;                                 \
+		} else if (x[j] > *max) {                                   \
+			*max = x[j];                                        \
+			*which_max = j + 1;                                 \
+		}                                                           \
+	}                                                                   \
+	return 1;                                                           \
 }
 
-#define PARTITIONED_WHICH_MAX(C_TYPE, ACCESSOR, NA_CHECK, INIT)             \
-{                                                                           \
-	PARTITIONED_WHICH_AGG(C_TYPE, ACCESSOR, NA_CHECK, INIT, >)          \
+DEFINE_RANGE_WITH_WHICH_FUN(int_range_with_which, int, INT_IS_NA)
+DEFINE_RANGE_WITH_WHICH_FUN(double_range_with_which, double, ISNAN)
+
+/* Same as which.min() or which.max() on each list element of 'x'. */
+static SEXP grouped_which(SEXP x, int is_max)
+{
+	SEXP unlistData, ends, ans;
+	int nends, i, prev_end, end, which_min, which_max, imin, imax;
+	const int *ends_p;
+	double dmin, dmax;
+
+	unlistData = _get_CompressedList_unlistData(x);
+	ends = _get_PartitioningByEnd_end(_get_CompressedList_partitioning(x));
+	nends = LENGTH(ends);
+	ends_p = INTEGER(ends);
+	PROTECT(ans = NEW_INTEGER(nends));
+	for (i = 0, prev_end = 0; i < nends; i++, prev_end = end) {
+		end = ends_p[i];
+		if (TYPEOF(unlistData) == REALSXP)
+			double_range_with_which(REAL(unlistData) + prev_end,
+				end - prev_end,
+				&which_min, &which_max, &dmin, &dmax);
+		else
+			int_range_with_which(INTEGER(unlistData) + prev_end,
+				end - prev_end,
+				&which_min, &which_max, &imin, &imax);
+		INTEGER(ans)[i] = is_max ? which_max : which_min;
+	}
+	SET_NAMES(ans, _get_CompressedList_names(x));
+	UNPROTECT(1);
+	return ans;
 }
 
 /* --- .Call ENTRY POINT --- */
 SEXP C_which_min_CompressedLogicalList(SEXP x)
 {
-	PARTITIONED_WHICH_MIN(Rboolean, LOGICAL, val == NA_LOGICAL, TRUE);
+	return grouped_which(x, 0);
 }
 
 /* --- .Call ENTRY POINT --- */
 SEXP C_which_min_CompressedIntegerList(SEXP x)
 {
-	PARTITIONED_WHICH_MIN(int, INTEGER, val == NA_INTEGER, INT_MAX);
+	return grouped_which(x, 0);
 }
 
 /* --- .Call ENTRY POINT --- */
 SEXP C_which_min_CompressedNumericList(SEXP x)
 {
-	PARTITIONED_WHICH_MIN(double, REAL, ISNA(val), R_PosInf);
+	return grouped_which(x, 0);
 }
 
 /* --- .Call ENTRY POINT --- */
 SEXP C_which_max_CompressedLogicalList(SEXP x)
 {
-	PARTITIONED_WHICH_MAX(Rboolean, LOGICAL, val == NA_LOGICAL, TRUE);
+	return grouped_which(x, 1);
 }
 
 /* --- .Call ENTRY POINT --- */
 SEXP C_which_max_CompressedIntegerList(SEXP x)
 {
-	PARTITIONED_WHICH_MAX(int, INTEGER, val == NA_INTEGER, R_INT_MIN);
+	return grouped_which(x, 1);
 }
 
 /* --- .Call ENTRY POINT --- */
 SEXP C_which_max_CompressedNumericList(SEXP x)
 {
-	PARTITIONED_WHICH_MAX(double, REAL, ISNA(val), R_NegInf);
+	return grouped_which(x, 1);
+}
+
+/* Returns the list of the min, max, which.min and which.max of each list
+   element of 'x'. Like min() and max() on 'x', the min and max are NA if
+   the list element contains NAs and 'na_rm' is FALSE (NaN if it contains
+   NaNs but no NAs), and are the identity of the operation if there are no
+   (non-NA) values. which.min and which.max always ignore the NAs. */
+static SEXP grouped_range_with_which(SEXP x, SEXP na_rm)
+{
+	SEXP unlistData, ends, ans, ans_min, ans_max, ans_which_min,
+	     ans_which_max, ans_names;
+	int nends, narm, is_lgl, is_real, i, prev_end, end, n, which_min,
+	    which_max, has_NA, imin, imax;
+	const int *ends_p;
+	double dmin, dmax;
+
+	unlistData = _get_CompressedList_unlistData(x);
+	ends = _get_PartitioningByEnd_end(_get_CompressedList_partitioning(x));
+	nends = LENGTH(ends);
+	ends_p = INTEGER(ends);
+	narm = asLogical(na_rm);
+	is_lgl = TYPEOF(unlistData) == LGLSXP;
+	is_real = TYPEOF(unlistData) == REALSXP;
+	PROTECT(ans_min = allocVector(TYPEOF(unlistData), nends));
+	PROTECT(ans_max = allocVector(TYPEOF(unlistData), nends));
+	PROTECT(ans_which_min = NEW_INTEGER(nends));
+	PROTECT(ans_which_max = NEW_INTEGER(nends));
+	for (i = 0, prev_end = 0; i < nends; i++, prev_end = end) {
+		end = ends_p[i];
+		n = end - prev_end;
+		if (is_real) {
+			const double *data = REAL(unlistData) + prev_end;
+			has_NA = double_range_with_which(data, n,
+				&which_min, &which_max, &dmin, &dmax);
+			if (has_NA && !narm) {
+				dmin = dmax = R_NaN;
+				for (int j = 0; j < n; j++) {
+					if (ISNA(data[j])) {
+						dmin = dmax = NA_REAL;
+						break;
+					}
+				}
+			} else if (which_min == NA_INTEGER) {
+				dmin = R_PosInf;
+				dmax = R_NegInf;
+			}
+			REAL(ans_min)[i] = dmin;
+			REAL(ans_max)[i] = dmax;
+		} else {
+			const int *data = INTEGER(unlistData) + prev_end;
+			has_NA = int_range_with_which(data, n,
+				&which_min, &which_max, &imin, &imax);
+			if (has_NA && !narm) {
+				imin = imax = NA_INTEGER;
+			} else if (which_min == NA_INTEGER) {
+				imin = is_lgl ? TRUE : INT_MAX;
+				imax = is_lgl ? FALSE : R_INT_MIN;
+			}
+			INTEGER(ans_min)[i] = imin;
+			INTEGER(ans_max)[i] = imax;
+		}
+		INTEGER(ans_which_min)[i] = which_min;
+		INTEGER(ans_which_max)[i] = which_max;
+	}
+	PROTECT(ans = NEW_LIST(4));
+	SET_VECTOR_ELT(ans, 0, ans_min);
+	SET_VECTOR_ELT(ans, 1, ans_max);
+	SET_VECTOR_ELT(ans, 2, ans_which_min);
+	SET_VECTOR_ELT(ans, 3, ans_which_max);
+	PROTECT(ans_names = NEW_CHARACTER(4));
+	SET_STRING_ELT(ans_names, 0, mkChar("min"));
+	SET_STRING_ELT(ans_names, 1, mkChar("max"));
+	SET_STRING_ELT(ans_names, 2, mkChar("which.min"));
+	SET_STRING_ELT(ans_names, 3, mkChar("which.max"));
+	SET_NAMES(ans, ans_names);
+	UNPROTECT(6);
+	return ans;
+}
+
+/* --- .Call ENTRY POINT --- */
+SEXP C_range_with_which_CompressedLogicalList(SEXP x, SEXP na_rm)
+{
+	return grouped_range_with_which(x, na_rm);
+}
+
+/* --- .Call ENTRY POINT --- */
+SEXP C_range_with_which_CompressedIntegerList(SEXP x, SEXP na_rm)
+{
+	return grouped_range_with_which(x, na_rm);
+}
+
+/* --- .Call ENTRY POINT --- */
+SEXP C_range_with_which_CompressedNumericList(SEXP x, SEXP na_rm)
+{
+	return grouped_range_with_which(x, na_rm);
 }
 
+/* Same as is.unsorted(x[0..n-1], na.rm, strictly). When there are no NAs,
+   the pairs of consecutive values are compared by blocks of
+   SORTEDNESS_BLOCK and the scan stops at the end of the first block that
+   contains a decreasing pair. */
 
-#define PARTITIONED_BREAK(C_TYPE, ACCESSOR, NA_CHECK, BREAK_CHECK, OFFSET)  \
+#define DEFINE_IS_UNSORTED_FUN(NAME, C_TYPE, IS_NA)                         \
+static int NAME(const C_TYPE *x, int n, int na_rm, int strictly)            \
 {                                                                           \
-	SEXP unlistData = _get_CompressedList_unlistData(x);                \
-	SEXP partition = _get_CompressedList_partitioning(x);               \
-	SEXP ends = _get_PartitioningByEnd_end(partition);                  \
-	Rboolean _na_rm = asLogical(na_rm);                                 \
-	int prev_end = 0;                                                   \
-	SEXP ans = allocVector(LGLSXP, length(ends));                       \
-	for (int i = 0; i < length(ends); i++) {                            \
-		int end = INTEGER(ends)[i];                                 \
-		Rboolean summary = FALSE;                                   \
-		for (int j = prev_end + OFFSET; j < end; j++) {             \
-			C_TYPE val = ACCESSOR(unlistData)[j];               \
-			if (NA_CHECK) {                                     \
-				if (_na_rm) {                               \
-					continue;                           \
-				} else {                                    \
-					summary = NA_LOGICAL;               \
-					break;                              \
-				}                                           \
-			}                                                   \
-			if (BREAK_CHECK) {                                  \
-				summary = TRUE;                             \
-				break;                                      \
+	int j, k, kmax, unsorted, has_NA, has_prev;                         \
+	C_TYPE prev;                                                        \
+                                                                            \
+	if (n <= 1)                                                         \
+		return FALSE;                                               \
+	has_NA = 0;                                                         \
+	for (j = 0; j < n; j++)                                             \
+		has_NA |= IS_NA(x[j]);                                      \
+	if (!has_NA) {                                                      \
+		for (j = 1; j < n; j = kmax) {                              \
+			kmax = j + SORTEDNESS_BLOCK < n ?                   \
+			       j + SORTEDNESS_BLOCK : n;                    \
+			unsorted = 0;                                       \
+			if (strictly) {                                     \
+				for (k = j; k < kmax; k++)                  \
+					unsorted |= x[k] <= x[k - 1];       \
+			} else {                                            \
+				for (k = j; k < kmax; k++)                  \
+					unsorted |= x[k] < x[k - 1];        \
 			}                                                   \
+			if (unsorted)                                       \
+				return TRUE;                                \
 		}                                                           \
-		LOGICAL(ans)[i] = summary;                                  \
-		prev_end = end;                                             \
+		return FALSE;                                               \
 	}                                                                   \
-	SET_NAMES(ans, _get_CompressedList_names(x));                       \
-	return ans;                                                         \
+	if (!na_rm)                                                         \
+		return NA_LOGICAL;                                          \
+	has_prev = 0;                                                       \
+	prev = 0;                                                           \
+	for (j = 0; j < n; j++) {                                           \
+		if (IS_NA(x[j]))                                            \
+			continue;                                           \
+		if (has_prev && (strictly ? x[j] <= prev : x[j] < prev))    \
+			return TRUE;                                        \
+		prev = x[j];                                                \
+		has_prev = 1;                                               \
+	}                                                                   \
+	return FALSE;                                                       \
 }
 
-#define PARTITIONED_IS_UNSORTED(C_TYPE, ACCESSOR, NA_CHECK)                 \
-{                                                                           \
-	if (asLogical(strictly)) {                                          \
-		PARTITIONED_BREAK(C_TYPE, ACCESSOR, NA_CHECK,               \
-				  val <= ACCESSOR(unlistData)[j-1], 1);     \
-	} else {                                                            \
-		PARTITIONED_BREAK(C_TYPE, ACCESSOR, NA_CHECK,               \
-				  val < ACCESSOR(unlistData)[j-1], 1);      \
-	}                                                                   \
+DEFINE_IS_UNSORTED_FUN(int_is_unsorted, int, INT_IS_NA)
+DEFINE_IS_UNSORTED_FUN(double_is_unsorted, double, ISNAN)
+
+static SEXP grouped_is_unsorted(SEXP x, SEXP na_rm, SEXP strictly)
+{
+	SEXP unlistData, ends, ans;
+	int nends, narm, strict, i, prev_end, end;
+	const int *ends_p;
+
+	unlistData = _get_CompressedList_unlistData(x);
+	ends = _get_PartitioningByEnd_end(_get_CompressedList_partitioning(x));
+	nends = LENGTH(ends);
+	ends_p = INTEGER(ends);
+	narm = asLogical(na_rm);
+	strict = asLogical(strictly);
+	PROTECT(ans = NEW_LOGICAL(nends));
+	for (i = 0, prev_end = 0; i < nends; i++, prev_end = end) {
+		end = ends_p[i];
+		if (TYPEOF(unlistData) == REALSXP)
+			LOGICAL(ans)[i] = double_is_unsorted(
+				REAL(unlistData) + prev_end, end - prev_end,
+				narm, strict);
+		else
+			LOGICAL(ans)[i] = int_is_unsorted(
+				INTEGER(unlistData) + prev_end, end - prev_end,
+				narm, strict);
+	}
+	SET_NAMES(ans, _get_CompressedList_names(x));
+	UNPROTECT(1);
+	return ans;
 }
 
 /* --- .Call ENTRY POINT --- */
 SEXP C_is_unsorted_CompressedLogicalList(SEXP x, SEXP na_rm, SEXP strictly)
 {
-	PARTITIONED_IS_UNSORTED(Rboolean, LOGICAL, val == NA_LOGICAL);
+	return grouped_is_unsorted(x, na_rm, strictly);
 }
 
 /* --- .Call ENTRY POINT --- */
 SEXP C_is_unsorted_CompressedIntegerList(SEXP x, SEXP na_rm, SEXP strictly)
 {
-	PARTITIONED_IS_UNSORTED(int, INTEGER, val == NA_INTEGER);
+	return grouped_is_unsorted(x, na_rm, strictly);
 }
 
 /* --- .Call ENTRY POINT --- */
 SEXP C_is_unsorted_CompressedNumericList(SEXP x, SEXP na_rm, SEXP strictly)
 {
-	PARTITIONED_IS_UNSORTED(double, REAL, ISNA(val));
+	return grouped_is_unsorted(x, na_rm, strictly);
+}
+
+
+
+/****************************************************************************
+ * Grouped mean, var, median, mad, and quantile
+ *
+ * The values of each list element are copied (as doubles) to a buffer and
+ * summarized with the same algorithms as mean(), var(), median(), mad(),
+ * and quantile(type=7), so the results are identical to what sapply()
+ * would return. Median and quantiles use partial sorting (rPsort()) of the
+ * buffer instead of a full sort of the list elements.
+ */
+
+#define GROUPED_MEAN	0
+#define GROUPED_VAR	1
+#define GROUPED_MEDIAN	2
+#define GROUPED_MAD	3
+
+/* Copy the values of list element [start, end) to 'buf' as doubles.
+   NAs (and NaNs) are dropped if 'na_rm' is TRUE. If 'na_rm' is FALSE and
+   'keep_na' is FALSE, returns -1 as soon as an NA is found. Otherwise
+   returns the nb of values copied. */
+static int element_as_doubles(SEXP unlistData, int start, int end,
+		int na_rm, int keep_na, double *buf)
+{
+	int n, j, iv;
+	double v;
+
+	n = 0;
+	if (TYPEOF(unlistData) == REALSXP) {
+		const double *data = REAL(unlistData);
+		for (j = start; j < end; j++) {
+			v = data[j];
+			if (ISNAN(v) && !keep_na) {
+				if (na_rm)
+					continue;
+				return -1;
+			}
+			buf[n++] = v;
+		}
+		return n;
+	}
+	/* LGLSXP or INTSXP */
+	const int *data = INTEGER(unlistData);
+	for (j = start; j < end; j++) {
+		iv = data[j];
+		if (iv == NA_INTEGER) {
+			if (na_rm)
+				continue;
+			return -1;
+		}
+		buf[n++] = (double) iv;
+	}
+	return n;
+}
+
+/* Same as the C code behind mean(). */
+static double mean_of_doubles(const double *x, int n, int is_int)
+{
+	long double s, t;
+	int i;
+
+	s = 0.0;
+	for (i = 0; i < n; i++)
+		s += x[i];
+	if (is_int)
+		return (double) (s / n);
+	s /= n;
+	if (R_FINITE((double) s)) {
+		t = 0.0;
+		for (i = 0; i < n; i++)
+			t += (x[i] - s);
+		s += t / n;
+	}
+	return (double) s;
+}
+
+/* Same as the C code behind var() (see cov_complete1() in R's cov.c). */
+static double var_of_doubles(const double *x, int n)
+{
+	long double sum, tmp;
+	double xm, dev;
+	int i;
+
+	if (n < 2)
+		return NA_REAL;
+	sum = 0.0;
+	for (i = 0; i < n; i++)
+		sum += x[i];
+	tmp = sum / n;
+	if (R_FINITE((double) tmp)) {
+		sum = 0.0;
+		for (i = 0; i < n; i++)
+			sum += (x[i] - tmp);
+		tmp = tmp + sum / n;
+	}
+	xm = (double) tmp;
+	sum = 0.0;
+	for (i = 0; i < n; i++) {
+		dev = x[i] - xm;
+		sum += dev * dev;
+	}
+	return (double) (sum / (n - 1));
+}
+
+/* Same as median() but always returns a double. Reorders 'x'. */
+static double median_of_doubles(double *x, int n, int is_int)
+{
+	int half;
+	double two[2];
+
+	if (n == 0)
+		return NA_REAL;
+	half = (n + 1) / 2;
+	rPsort(x, n, half - 1);
+	if (n % 2 == 1)
+		return x[half - 1];
+	/* 'x[half]' is the smallest value in 'x[half..n-1]'. */
+	rPsort(x + half, n - half, 0);
+	two[0] = x[half - 1];
+	two[1] = x[half];
+	return mean_of_doubles(two, 2, is_int);
+}
+
+static SEXP grouped_stat(SEXP x, SEXP na_rm, int stat)
+{
+	SEXP unlistData, ends, ans;
+	int nends, prev_end, end, max_len, i, n, j, is_int, narm;
+	const int *ends_p;
+	double *buf, center;
+
+	unlistData = _get_CompressedList_unlistData(x);
+	ends = _get_PartitioningByEnd_end(_get_CompressedList_partitioning(x));
+	narm = asLogical(na_rm);
+	is_int = TYPEOF(unlistData) != REALSXP;
+	nends = LENGTH(ends);
+	ends_p = INTEGER(ends);
+	max_len = 0;
+	for (i = 0, prev_end = 0; i < nends; prev_end = ends_p[i], i++)
+		if (ends_p[i] - prev_end > max_len)
+			max_len = ends_p[i] - prev_end;
+	buf = (double *) R_alloc((long) max_len, sizeof(double));
+	PROTECT(ans = NEW_NUMERIC(nends));
+	for (i = 0, prev_end = 0; i < nends; i++) {
+		end = ends_p[i];
+		/* Unless 'na.rm' is TRUE, mean() propagates NaNs and NAs
+		   thru the arithmetic. */
+		n = element_as_doubles(unlistData, prev_end, end, narm,
+				stat == GROUPED_MEAN && !is_int && !narm, buf);
+		prev_end = end;
+		if (n == -1) {
+			REAL(ans)[i] = NA_REAL;
+			continue;
+		}
+		switch (stat) {
+		    case GROUPED_MEAN:
+			REAL(ans)[i] = mean_of_doubles(buf, n, is_int);
+			break;
+		    case GROUPED_VAR:
+			REAL(ans)[i] = var_of_doubles(buf, n);
+			break;
+		    case GROUPED_MEDIAN:
+			REAL(ans)[i] = median_of_doubles(buf, n, is_int);
+			break;
+		    case GROUPED_MAD:
+			/* median(abs(x - center)) with center=median(x).
+			   The deviations are integers only if 'center' is
+			   (i.e. if 'n' is odd). */
+			center = median_of_doubles(buf, n, is_int);
+			for (j = 0; j < n; j++)
+				buf[j] = fabs(buf[j] - center);
+			REAL(ans)[i] = median_of_doubles(buf, n,
+					is_int && n % 2 == 1);
+			break;
+		}
+	}
+	SET_NAMES(ans, _get_CompressedList_names(x));
+	UNPROTECT(1);
+	return ans;
+}
+
+/* --- .Call ENTRY POINT --- */
+SEXP C_mean_CompressedLogicalList(SEXP x, SEXP na_rm)
+{
+	return grouped_stat(x, na_rm, GROUPED_MEAN);
+}
+
+/* --- .Call ENTRY POINT --- */
+SEXP C_mean_CompressedIntegerList(SEXP x, SEXP na_rm)
+{
+	return grouped_stat(x, na_rm, GROUPED_MEAN);
+}
+
+/* --- .Call ENTRY POINT --- */
+SEXP C_mean_CompressedNumericList(SEXP x, SEXP na_rm)
+{
+	return grouped_stat(x, na_rm, GROUPED_MEAN);
+}
+
+/* --- .Call ENTRY POINT --- */
+SEXP C_var_CompressedLogicalList(SEXP x, SEXP na_rm)
+{
+	return grouped_stat(x, na_rm, GROUPED_VAR);
+}
+
+/* --- .Call ENTRY POINT --- */
+SEXP C_var_CompressedIntegerList(SEXP x, SEXP na_rm)
+{
+	return grouped_stat(x, na_rm, GROUPED_VAR);
+}
+
+/* --- .Call ENTRY POINT --- */
+SEXP C_var_CompressedNumericList(SEXP x, SEXP na_rm)
+{
+	return grouped_stat(x, na_rm, GROUPED_VAR);
+}
+
+/* --- .Call ENTRY POINT --- */
+SEXP C_median_CompressedLogicalList(SEXP x, SEXP na_rm)
+{
+	return grouped_stat(x, na_rm, GROUPED_MEDIAN);
+}
+
+/* --- .Call ENTRY POINT --- */
+SEXP C_median_CompressedIntegerList(SEXP x, SEXP na_rm)
+{
+	return grouped_stat(x, na_rm, GROUPED_MEDIAN);
+}
+
+/* --- .Call ENTRY POINT --- */
+SEXP C_median_CompressedNumericList(SEXP x, SEXP na_rm)
+{
+	return grouped_stat(x, na_rm, GROUPED_MEDIAN);
+}
+
+/* --- .Call ENTRY POINT --- */
+SEXP C_mad_CompressedLogicalList(SEXP x, SEXP na_rm)
+{
+	return grouped_stat(x, na_rm, GROUPED_MAD);
+}
+
+/* --- .Call ENTRY POINT --- */
+SEXP C_mad_CompressedIntegerList(SEXP x, SEXP na_rm)
+{
+	return grouped_stat(x, na_rm, GROUPED_MAD);
+}
+
+/* --- .Call ENTRY POINT --- */
+SEXP C_mad_CompressedNumericList(SEXP x, SEXP na_rm)
+{
+	return grouped_stat(x, na_rm, GROUPED_MAD);
+}
+
+/* Same as quantile(x, probs, type=7, names=FALSE) on the 'n' values in 'x'
+   but always returns doubles. Reorders 'x'. 'order' contains the indices
+   of 'probs' sorted by increasing prob. */
+static void quantiles_of_doubles(double *x, int n,
+		const double *probs, const int *order, int nprobs, double *out)
+{
+	int k, p, lo, hi, sorted_upto;
+	double index, h, qs, x_hi;
+
+	if (n == 0) {
+		for (p = 0; p < nprobs; p++)
+			out[p] = NA_REAL;
+		return;
+	}
+	/* The needed order statistics are selected in increasing order so
+	   each rPsort() only works on the tail of 'x': 'x[sorted_upto-1]' is
+	   in its final place and 'x[sorted_upto..n-1]' are all >= it. */
+	sorted_upto = 0;
+	for (k = 0; k < nprobs; k++) {
+		p = order[k];
+		index = 1 + (double) (n - 1) * probs[p];
+		lo = (int) floor(index);
+		hi = (int) ceil(index);
+		if (lo > sorted_upto) {
+			rPsort(x + sorted_upto, n - sorted_upto,
+			       lo - 1 - sorted_upto);
+			sorted_upto = lo;
+		}
+		if (hi > sorted_upto) {
+			rPsort(x + sorted_upto, n - sorted_upto,
+			       hi - 1 - sorted_upto);
+			sorted_upto = hi;
+		}
+		qs = x[lo - 1];
+		x_hi = x[hi - 1];
+		if (index > lo && x_hi != qs) {
+			h = index - lo;
+			qs = (1 - h) * qs + h * x_hi;
+		}
+		out[p] = qs;
+	}
+	return;
+}
+
+static SEXP grouped_quantile(SEXP x, SEXP probs, SEXP na_rm)
+{
+	SEXP unlistData, ends, ans;
+	int nends, nprobs, prev_end, end, max_len, i, n, narm, *order;
+	const int *ends_p;
+	double *buf, *sorted_probs;
+
+	unlistData = _get_CompressedList_unlistData(x);
+	ends = _get_PartitioningByEnd_end(_get_CompressedList_partitioning(x));
+	narm = asLogical(na_rm);
+	nends = LENGTH(ends);
+	ends_p = INTEGER(ends);
+	nprobs = LENGTH(probs);
+	sorted_probs = (double *) R_alloc((long) nprobs, sizeof(double));
+	order = (int *) R_alloc((long) nprobs, sizeof(int));
+	for (i = 0; i < nprobs; i++) {
+		sorted_probs[i] = REAL(probs)[i];
+		order[i] = i;
+	}
+	rsort_with_index(sorted_probs, order, nprobs);
+	max_len = 0;
+	for (i = 0, prev_end = 0; i < nends; prev_end = ends_p[i], i++)
+		if (ends_p[i] - prev_end > max_len)
+			max_len = ends_p[i] - prev_end;
+	buf = (double *) R_alloc((long) max_len, sizeof(double));
+	PROTECT(ans = allocMatrix(REALSXP, nprobs, nends));
+	for (i = 0, prev_end = 0; i < nends; i++) {
+		end = ends_p[i];
+		n = element_as_doubles(unlistData, prev_end, end, narm, 0, buf);
+		prev_end = end;
+		if (n == -1)
+			error("missing values and NaN's not allowed "
+			      "if 'na.rm' is FALSE");
+		quantiles_of_doubles(buf, n, REAL(probs), order, nprobs,
+				     REAL(ans) + (long) i * nprobs);
+	}
+	UNPROTECT(1);
+	return ans;
+}
+
+/* --- .Call ENTRY POINT --- */
+SEXP C_quantile_CompressedLogicalList(SEXP x, SEXP probs, SEXP na_rm)
+{
+	return grouped_quantile(x, probs, na_rm);
+}
+
+/* --- .Call ENTRY POINT --- */
+SEXP C_quantile_CompressedIntegerList(SEXP x, SEXP probs, SEXP na_rm)
+{
+	return grouped_quantile(x, probs, na_rm);
+}
+
+/* --- .Call ENTRY POINT --- */
+SEXP C_quantile_CompressedNumericList(SEXP x, SEXP probs, SEXP na_rm)
+{
+	return grouped_quantile(x, probs, na_rm);
+}
+
+
+/****************************************************************************
+ * Grouped cumsum(), cumprod(), cummin(), cummax() and diff()
+ *
+ * The results have the same length as 'unlistData' (cum*) or are shorter
+ * by 'lag * differences' per list element (diff), so they can be relisted
+ * by the caller on the partitioning of 'x' (or on new widths for diff)
+ * without going thru lapply().
+ */
+
+#define GROUPED_CUMSUM	0
+#define GROUPED_CUMPROD	1
+#define GROUPED_CUMMIN	2
+#define GROUPED_CUMMAX	3
+
+/* Same as the C code behind cumsum(), cummin() and cummax() on an integer
+   vector: an NA (or an integer overflow for cumsum) turns all the remaining
+   values of the list element into NAs. */
+static int int_cum(const int *x, int n, int op, int *out)
+{
+	int j, v, acc, overflow;
+	double sum;
+
+	overflow = 0;
+	sum = 0.0;
+	acc = 0;
+	for (j = 0; j < n; j++) {
+		v = x[j];
+		if (v == NA_INTEGER)
+			break;
+		if (op == GROUPED_CUMSUM) {
+			/* Exact: the partial sums stay within 2^32. */
+			sum += v;
+			if (sum > INT_MAX || sum < R_INT_MIN) {
+				overflow = 1;
+				break;
+			}
+			acc = (int) sum;
+		} else if (j == 0
+			|| (op == GROUPED_CUMMIN && v < acc)
+			|| (op == GROUPED_CUMMAX && v > acc)) {
+			acc = v;
+		}
+		out[j] = acc;
+	}
+	for ( ; j < n; j++)
+		out[j] = NA_INTEGER;
+	return overflow;
+}
+
+/* Same as the C code behind cumsum(), cumprod(), cummin() and cummax() on
+   a double vector. */
+static void double_cum(const double *x, int n, int op, double *out)
+{
+	int j;
+	long double acc;
+	double ex, v;
+
+	switch (op) {
+	    case GROUPED_CUMSUM:
+	    case GROUPED_CUMPROD:
+		acc = op == GROUPED_CUMSUM ? 0.0 : 1.0;
+		for (j = 0; j < n; j++) {
+			if (op == GROUPED_CUMSUM)
+				acc += x[j];
+			else
+				acc *= x[j];
+			out[j] = (double) acc;
+		}
+		break;
+	    case GROUPED_CUMMIN:
+	    case GROUPED_CUMMAX:
+		ex = op == GROUPED_CUMMIN ? R_PosInf : R_NegInf;
+		for (j = 0; j < n; j++) {
+			v = x[j];
+			if (ISNAN(v) || ISNAN(ex))
+				ex = ex + v;  /* propagate NA and NaN */
+			else if (op == GROUPED_CUMMIN ? v < ex : v > ex)
+				ex = v;
+			out[j] = ex;
+		}
+		break;
+	}
+	return;
+}
+
+static SEXP grouped_cum(SEXP x, int op)
+{
+	SEXP unlistData, ends, ans;
+	int nends, i, prev_end, end, overflow;
+	const int *ends_p;
+
+	unlistData = _get_CompressedList_unlistData(x);
+	ends = _get_PartitioningByEnd_end(_get_CompressedList_partitioning(x));
+	nends = LENGTH(ends);
+	ends_p = INTEGER(ends);
+	overflow = 0;
+	if (TYPEOF(unlistData) != REALSXP && op != GROUPED_CUMPROD) {
+		const int *data = INTEGER(unlistData);
+		PROTECT(ans = NEW_INTEGER(LENGTH(unlistData)));
+		for (i = 0, prev_end = 0; i < nends; i++, prev_end = end) {
+			end = ends_p[i];
+			overflow |= int_cum(data + prev_end, end - prev_end,
+					    op, INTEGER(ans) + prev_end);
+		}
+	} else {
+		/* cumprod() on integers is done in double precision. */
+		PROTECT(unlistData = coerceVector(unlistData, REALSXP));
+		const double *data = REAL(unlistData);
+		PROTECT(ans = NEW_NUMERIC(LENGTH(unlistData)));
+		for (i = 0, prev_end = 0; i < nends; i++, prev_end = end) {
+			end = ends_p[i];
+			double_cum(data + prev_end, end - prev_end,
+				   op, REAL(ans) + prev_end);
+		}
+		UNPROTECT(1);
+	}
+	SET_NAMES(ans, GET_NAMES(unlistData));
+	UNPROTECT(1);
+	if (overflow)
+		warning("integer overflow in 'cumsum'; "
+			"use 'cumsum(as.numeric(.))'");
+	return ans;
+}
+
+/* --- .Call ENTRY POINT --- */
+SEXP C_cumsum_CompressedLogicalList(SEXP x)
+{
+	return grouped_cum(x, GROUPED_CUMSUM);
+}
+
+/* --- .Call ENTRY POINT --- */
+SEXP C_cumsum_CompressedIntegerList(SEXP x)
+{
+	return grouped_cum(x, GROUPED_CUMSUM);
+}
+
+/* --- .Call ENTRY POINT --- */
+SEXP C_cumsum_CompressedNumericList(SEXP x)
+{
+	return grouped_cum(x, GROUPED_CUMSUM);
+}
+
+/* --- .Call ENTRY POINT --- */
+SEXP C_cumprod_CompressedLogicalList(SEXP x)
+{
+	return grouped_cum(x, GROUPED_CUMPROD);
 }
 
+/* --- .Call ENTRY POINT --- */
+SEXP C_cumprod_CompressedIntegerList(SEXP x)
+{
+	return grouped_cum(x, GROUPED_CUMPROD);
+}
+
+/* --- .Call ENTRY POINT --- */
+SEXP C_cumprod_CompressedNumericList(SEXP x)
+{
+	return grouped_cum(x, GROUPED_CUMPROD);
+}
+
+/* --- .Call ENTRY POINT --- */
+SEXP C_cummin_CompressedLogicalList(SEXP x)
+{
+	return grouped_cum(x, GROUPED_CUMMIN);
+}
+
+/* --- .Call ENTRY POINT --- */
+SEXP C_cummin_CompressedIntegerList(SEXP x)
+{
+	return grouped_cum(x, GROUPED_CUMMIN);
+}
+
+/* --- .Call ENTRY POINT --- */
+SEXP C_cummin_CompressedNumericList(SEXP x)
+{
+	return grouped_cum(x, GROUPED_CUMMIN);
+}
+
+/* --- .Call ENTRY POINT --- */
+SEXP C_cummax_CompressedLogicalList(SEXP x)
+{
+	return grouped_cum(x, GROUPED_CUMMAX);
+}
+
+/* --- .Call ENTRY POINT --- */
+SEXP C_cummax_CompressedIntegerList(SEXP x)
+{
+	return grouped_cum(x, GROUPED_CUMMAX);
+}
+
+/* --- .Call ENTRY POINT --- */
+SEXP C_cummax_CompressedNumericList(SEXP x)
+{
+	return grouped_cum(x, GROUPED_CUMMAX);
+}
+
+/* Same as integer subtraction in R. */
+static int int_minus(int a, int b, int *overflow)
+{
+	if (a == NA_INTEGER || b == NA_INTEGER)
+		return NA_INTEGER;
+	if ((b < 0 && a > INT_MAX + b) || (b > 0 && a < R_INT_MIN + b)) {
+		*overflow = 1;
+		return NA_INTEGER;
+	}
+	return a - b;
+}
+
+/* The differences are computed in place in 'buf' (which holds a copy of
+   the list element): at each iteration, buf[j + lag] is read before being
+   overwritten. Like diff(), the result keeps the names of the last values
+   of each list element. */
+static SEXP grouped_diff(SEXP x, SEXP lag, SEXP differences)
+{
+	SEXP unlistData, ends, ans, unlistData_names, ans_names;
+	int nends, is_int, lag0, diffs0, i, j, d, n, prev_end, end,
+	    max_len, ans_len, ans_offset, overflow;
+	const int *ends_p;
+	int *ibuf;
+	double *dbuf;
+
+	unlistData = _get_CompressedList_unlistData(x);
+	ends = _get_PartitioningByEnd_end(_get_CompressedList_partitioning(x));
+	nends = LENGTH(ends);
+	ends_p = INTEGER(ends);
+	is_int = TYPEOF(unlistData) != REALSXP;
+	lag0 = INTEGER(lag)[0];
+	diffs0 = INTEGER(differences)[0];
+	max_len = ans_len = 0;
+	for (i = 0, prev_end = 0; i < nends; prev_end = ends_p[i], i++) {
+		n = ends_p[i] - prev_end;
+		if (n > max_len)
+			max_len = n;
+		if ((double) lag0 * diffs0 < n)
+			ans_len += n - lag0 * diffs0;
+	}
+	ibuf = NULL;
+	dbuf = NULL;
+	if (is_int) {
+		ibuf = (int *) R_alloc((long) max_len, sizeof(int));
+		PROTECT(ans = NEW_INTEGER(ans_len));
+	} else {
+		dbuf = (double *) R_alloc((long) max_len, sizeof(double));
+		PROTECT(ans = NEW_NUMERIC(ans_len));
+	}
+	unlistData_names = GET_NAMES(unlistData);
+	ans_names = R_NilValue;
+	if (unlistData_names != R_NilValue) {
+		PROTECT(ans_names = NEW_CHARACTER(ans_len));
+		SET_NAMES(ans, ans_names);
+		UNPROTECT(1);
+	}
+	overflow = 0;
+	ans_offset = 0;
+	for (i = 0, prev_end = 0; i < nends; i++, prev_end = end) {
+		end = ends_p[i];
+		n = end - prev_end;
+		if ((double) lag0 * diffs0 >= n)
+			continue;
+		if (ans_names != R_NilValue) {
+			for (j = 0; j < n - lag0 * diffs0; j++)
+				SET_STRING_ELT(ans_names, ans_offset + j,
+					STRING_ELT(unlistData_names,
+						end - (n - lag0 * diffs0) + j));
+		}
+		if (is_int) {
+			memcpy(ibuf, INTEGER(unlistData) + prev_end,
+			       sizeof(int) * n);
+			for (d = 0; d < diffs0; d++) {
+				n -= lag0;
+				for (j = 0; j < n; j++)
+					ibuf[j] = int_minus(ibuf[j + lag0],
+							    ibuf[j],
+							    &overflow);
+			}
+			memcpy(INTEGER(ans) + ans_offset, ibuf,
+			       sizeof(int) * n);
+		} else {
+			memcpy(dbuf, REAL(unlistData) + prev_end,
+			       sizeof(double) * n);
+			for (d = 0; d < diffs0; d++) {
+				n -= lag0;
+				for (j = 0; j < n; j++)
+					dbuf[j] = dbuf[j + lag0] - dbuf[j];
+			}
+			memcpy(REAL(ans) + ans_offset, dbuf,
+			       sizeof(double) * n);
+		}
+		ans_offset += n;
+	}
+	UNPROTECT(1);
+	if (overflow)
+		warning("NAs produced by integer overflow");
+	return ans;
+}
+
+/* --- .Call ENTRY POINT --- */
+SEXP C_diff_CompressedLogicalList(SEXP x, SEXP lag, SEXP differences)
+{
+	return grouped_diff(x, lag, differences);
+}
+
+/* --- .Call ENTRY POINT --- */
+SEXP C_diff_CompressedIntegerList(SEXP x, SEXP lag, SEXP differences)
+{
+	return grouped_diff(x, lag, differences);
+}
+
+/* --- .Call ENTRY POINT --- */
+SEXP C_diff_CompressedNumericList(SEXP x, SEXP lag, SEXP differences)
+{
+	return grouped_diff(x, lag, differences);
+}
+
+
+/****************************************************************************
+ * Grouped running window statistics
+ *
+ * The windows never cross list element boundaries. Like the runsum(),
+ * runmean(), runwtsum() and runq() methods for Rle objects, a list element
+ * of length n < k is treated with the largest odd window size <= n.
+ * runsum() and runmean() slide an accumulator over the element (O(n));
+ * runq() and runmed() maintain the window in a pair of heaps (O(n log k)).
+ */
+
+#define RUN_SUM		0
+#define RUN_MEAN	1
+#define RUN_WTSUM	2
+#define RUN_Q		3
+#define RUN_MED		4
+
+#define ENDRULE_DROP		0
+#define ENDRULE_CONSTANT	1
+#define ENDRULE_KEEP		2
+#define ENDRULE_MEDIAN		3
+
+static int get_endrule(SEXP endrule)
+{
+	const char *s;
+
+	s = CHAR(STRING_ELT(endrule, 0));
+	if (strcmp(s, "drop") == 0)
+		return ENDRULE_DROP;
+	if (strcmp(s, "constant") == 0)
+		return ENDRULE_CONSTANT;
+	if (strcmp(s, "keep") == 0)
+		return ENDRULE_KEEP;
+	if (strcmp(s, "median") == 0)
+		return ENDRULE_MEDIAN;
+	error("invalid 'endrule' value");
+	return -1;
+}
+
+static int effective_k(int k, int n)
+{
+	return n >= k ? k : 1 + 2 * ((n - 1) / 2);
+}
+
+/* Sliding sum (or mean) of the windows of size 'k' over 'x'. The infinite
+   and NA/NaN values are counted separately so they can leave the window
+   without corrupting the sum of the finite values. */
+static void run_sum(const double *x, int n, int k, int na_rm, int mean,
+		double *out)
+{
+	long double sum;
+	int j, t, nna, nnan, npinf, nninf, delta;
+	double v, ans;
+
+	sum = 0.0;
+	nna = nnan = npinf = nninf = 0;
+	for (j = 0; j < n; j++) {
+		for (t = 0; t < 2; t++) {
+			/* t == 0: x[j] enters the window;
+			   t == 1: x[j - k] leaves it */
+			if (t == 1 && j < k)
+				break;
+			v = t == 0 ? x[j] : x[j - k];
+			delta = t == 0 ? 1 : -1;
+			if (ISNA(v))
+				nna += delta;
+			else if (ISNAN(v))
+				nnan += delta;
+			else if (v == R_PosInf)
+				npinf += delta;
+			else if (v == R_NegInf)
+				nninf += delta;
+			else if (t == 0)
+				sum += v;
+			else
+				sum -= v;
+		}
+		if (j < k - 1)
+			continue;
+		if (!na_rm && nna != 0)
+			ans = NA_REAL;
+		else if ((!na_rm && nnan != 0) || (npinf != 0 && nninf != 0))
+			ans = R_NaN;
+		else if (npinf != 0)
+			ans = R_PosInf;
+		else if (nninf != 0)
+			ans = R_NegInf;
+		else
+			ans = (double) sum;
+		if (mean)
+			ans /= na_rm ? k - nna - nnan : k;
+		out[j - k + 1] = ans;
+	}
+	return;
+}
+
+static void run_wtsum(const double *x, int n, int k, const double *wt,
+		int na_rm, double *out)
+{
+	long double sum;
+	int j, t;
+	double v;
+
+	for (j = 0; j + k <= n; j++) {
+		sum = 0.0;
+		for (t = 0; t < k; t++) {
+			v = x[j + t];
+			if (na_rm && ISNAN(v))
+				continue;
+			sum += v * wt[t];
+		}
+		out[j] = (double) sum;
+	}
+	return;
+}
+
+/* The window of size 'k' is kept in 'heap': heap[0..i-1] is a max-heap of
+   its 'i' smallest values and heap[i..k-1] a min-heap of the others, so
+   the i-th smallest value is at the top of the max-heap. The heaps store
+   the slots of 'val' (x[j] is in slot j % k) and 'pos' maps each slot back
+   to its position in 'heap'. */
+typedef struct window_heaps_t {
+	int k, i;
+	double *val;
+	int *heap, *pos;
+} WindowHeaps;
+
+static int above(const WindowHeaps *wh, int slot1, int slot2, int in_lo)
+{
+	return in_lo ? wh->val[slot1] > wh->val[slot2]
+		     : wh->val[slot1] < wh->val[slot2];
+}
+
+static void heap_swap(WindowHeaps *wh, int p1, int p2)
+{
+	int tmp;
+
+	tmp = wh->heap[p1];
+	wh->heap[p1] = wh->heap[p2];
+	wh->heap[p2] = tmp;
+	wh->pos[wh->heap[p1]] = p1;
+	wh->pos[wh->heap[p2]] = p2;
+	return;
+}
+
+/* 'p' is relative to the start ('offset') of the heap. */
+static void sift(WindowHeaps *wh, int p, int in_lo)
+{
+	int offset, size, parent, child, best;
+
+	offset = in_lo ? 0 : wh->i;
+	size = in_lo ? wh->i : wh->k - wh->i;
+	while (p > 0) {
+		parent = (p - 1) / 2;
+		if (!above(wh, wh->heap[offset + p],
+			       wh->heap[offset + parent], in_lo))
+			break;
+		heap_swap(wh, offset + p, offset + parent);
+		p = parent;
+	}
+	while (1) {
+		best = p;
+		for (child = 2 * p + 1; child <= 2 * p + 2; child++)
+			if (child < size &&
+			    above(wh, wh->heap[offset + child],
+				      wh->heap[offset + best], in_lo))
+				best = child;
+		if (best == p)
+			break;
+		heap_swap(wh, offset + p, offset + best);
+		p = best;
+	}
+	return;
+}
+
+static void init_WindowHeaps(WindowHeaps *wh, const double *x, double *tmp)
+{
+	int s, p;
+
+	for (s = 0; s < wh->k; s++) {
+		wh->val[s] = tmp[s] = x[s];
+		wh->pos[s] = s;
+	}
+	rsort_with_index(tmp, wh->pos, wh->k);
+	/* wh->pos now holds the slots in increasing order of their value.
+	   The max-heap gets the 'i' smallest in decreasing order, the
+	   min-heap the others in increasing order. */
+	for (p = 0; p < wh->i; p++)
+		wh->heap[p] = wh->pos[wh->i - 1 - p];
+	for (p = wh->i; p < wh->k; p++)
+		wh->heap[p] = wh->pos[p];
+	for (p = 0; p < wh->k; p++)
+		wh->pos[wh->heap[p]] = p;
+	return;
+}
+
+static void replace_in_WindowHeaps(WindowHeaps *wh, int slot, double v)
+{
+	int p;
+
+	wh->val[slot] = v;
+	p = wh->pos[slot];
+	if (p < wh->i)
+		sift(wh, p, 1);
+	else
+		sift(wh, p - wh->i, 0);
+	if (wh->i < wh->k &&
+	    wh->val[wh->heap[0]] > wh->val[wh->heap[wh->i]])
+	{
+		heap_swap(wh, 0, wh->i);
+		sift(wh, 0, 1);
+		sift(wh, 0, 0);
+	}
+	return;
+}
+
+/* i-th smallest value of the windows of size 'k' over 'x' (which contains
+   no NA or NaN). */
+static void run_q_with_heaps(const double *x, int n, int k, int i,
+		WindowHeaps *wh, double *tmp, double *out)
+{
+	int j;
+
+	wh->k = k;
+	wh->i = i;
+	init_WindowHeaps(wh, x, tmp);
+	out[0] = wh->val[wh->heap[0]];
+	for (j = k; j < n; j++) {
+		replace_in_WindowHeaps(wh, j % k, x[j]);
+		out[j - k + 1] = wh->val[wh->heap[0]];
+	}
+	return;
+}
+
+/* Same as runq() on an Rle: when the window contains NAs, they are dropped
+   (if 'na_rm' is TRUE) and 'i' is scaled to the nb of remaining values. */
+static void run_q_with_NAs(const double *x, int n, int k, int i, int na_rm,
+		double *tmp, double *out)
+{
+	int j, t, m, q;
+	double v;
+
+	for (j = 0; j + k <= n; j++) {
+		m = 0;
+		for (t = 0; t < k; t++) {
+			v = x[j + t];
+			if (!ISNAN(v))
+				tmp[m++] = v;
+		}
+		if (m == 0 || (!na_rm && m < k)) {
+			out[j] = NA_REAL;
+			continue;
+		}
+		q = m == k ? i : (int) (m * ((double) i / k) + 0.5);
+		if (q > 0)
+			q--;
+		rPsort(tmp, m, q);
+		out[j] = tmp[q];
+	}
+	return;
+}
+
+static double med3(double a, double b, double c)
+{
+	double m;
+
+	m = b;
+	if (a < b) {
+		if (c < b)
+			m = a >= c ? a : c;
+	} else {
+		if (c > b)
+			m = a <= c ? a : c;
+	}
+	return m;
+}
+
+/* Same as smoothEnds(y, k) in the stats package. 'sm' holds a copy of 'y'
+   on entry. */
+static void smooth_ends(const double *y, int n, int k, double *sm,
+		double *tmp)
+{
+	int k2, i, ii;
+
+	k2 = k / 2;
+	if (k2 < 1)
+		return;
+	if (k2 >= 2) {
+		sm[1] = med3(y[0], y[1], y[2]);
+		sm[n - 2] = med3(y[n - 1], y[n - 2], y[n - 3]);
+		for (i = 3; i <= k2; i++) {
+			ii = 2 * i - 1;
+			memcpy(tmp, y, sizeof(double) * ii);
+			rPsort(tmp, ii, i - 1);
+			sm[i - 1] = tmp[i - 1];
+			memcpy(tmp, y + n - ii, sizeof(double) * ii);
+			rPsort(tmp, ii, i - 1);
+			sm[n - i] = tmp[i - 1];
+		}
+	}
+	sm[0] = med3(y[0], sm[1], 3 * sm[1] - 2 * sm[2]);
+	sm[n - 1] = med3(y[n - 1], sm[n - 2], 3 * sm[n - 2] - 2 * sm[n - 3]);
+	return;
+}
+
+static SEXP grouped_run(SEXP x, SEXP k, int stat, SEXP i, SEXP wt,
+		SEXP endrule, SEXP na_rm)
+{
+	SEXP unlistData, ends, ans;
+	int nends, k0, i0, rule, narm, is_int, int_ans, max_len, ans_len,
+	    g, j, n, keff, nwin, pad, prev_end, end, ans_offset, has_na,
+	    overflow;
+	const int *ends_p;
+	double *xbuf, *wbuf, *tmp, *out, v;
+	WindowHeaps wh;
+
+	unlistData = _get_CompressedList_unlistData(x);
+	ends = _get_PartitioningByEnd_end(_get_CompressedList_partitioning(x));
+	nends = LENGTH(ends);
+	ends_p = INTEGER(ends);
+	k0 = INTEGER(k)[0];
+	i0 = stat == RUN_Q ? INTEGER(i)[0] : k0 / 2 + 1;
+	rule = get_endrule(endrule);
+	narm = stat == RUN_MED ? 0 : asLogical(na_rm);
+	is_int = TYPEOF(unlistData) != REALSXP;
+	int_ans = is_int && (stat == RUN_SUM || stat == RUN_Q);
+
+	max_len = ans_len = 0;
+	for (g = 0, prev_end = 0; g < nends; prev_end = ends_p[g], g++) {
+		n = ends_p[g] - prev_end;
+		if (n == 0)
+			continue;
+		if (n > max_len)
+			max_len = n;
+		keff = effective_k(k0, n);
+		/* Checked at the R level. */
+		if (keff != k0 && stat == RUN_WTSUM)
+			error("'k' is bigger than the length of some "
+			      "list elements");
+		if (keff < i0 && stat == RUN_Q)
+			error("'i' must be >= 1 and <= 'k'");
+		ans_len += rule == ENDRULE_DROP ? n - keff + 1 : n;
+	}
+	xbuf = (double *) R_alloc((long) max_len, sizeof(double));
+	wbuf = (double *) R_alloc((long) max_len, sizeof(double));
+	tmp = (double *) R_alloc((long) max_len, sizeof(double));
+	wh.val = (double *) R_alloc((long) max_len, sizeof(double));
+	wh.heap = (int *) R_alloc((long) max_len, sizeof(int));
+	wh.pos = (int *) R_alloc((long) max_len, sizeof(int));
+
+	PROTECT(ans = int_ans ? NEW_INTEGER(ans_len) : NEW_NUMERIC(ans_len));
+	overflow = 0;
+	ans_offset = 0;
+	for (g = 0, prev_end = 0; g < nends; g++, prev_end = end) {
+		end = ends_p[g];
+		n = end - prev_end;
+		if (n == 0)
+			continue;
+		has_na = 0;
+		for (j = 0; j < n; j++) {
+			if (is_int) {
+				v = INTEGER(unlistData)[prev_end + j];
+				v = v == NA_INTEGER ? NA_REAL : v;
+			} else {
+				v = REAL(unlistData)[prev_end + j];
+			}
+			has_na |= ISNAN(v);
+			xbuf[j] = v;
+		}
+		keff = effective_k(k0, n);
+		nwin = n - keff + 1;
+		/* The window statistics go in wbuf[pad..pad+nwin-1]. */
+		pad = rule == ENDRULE_DROP ? 0 : (keff - 1) / 2;
+		out = wbuf + pad;
+		switch (stat) {
+		    case RUN_SUM:
+		    case RUN_MEAN:
+			run_sum(xbuf, n, keff, narm, stat == RUN_MEAN, out);
+			break;
+		    case RUN_WTSUM:
+			run_wtsum(xbuf, n, keff, REAL(wt), narm, out);
+			break;
+		    case RUN_Q:
+		    case RUN_MED:
+			if (has_na)
+				run_q_with_NAs(xbuf, n, keff,
+					stat == RUN_Q ? i0 : keff / 2 + 1,
+					narm, tmp, out);
+			else
+				run_q_with_heaps(xbuf, n, keff,
+					stat == RUN_Q ? i0 : keff / 2 + 1,
+					&wh, tmp, out);
+			break;
+		}
+		for (j = 0; j < pad; j++) {
+			if (rule == ENDRULE_CONSTANT) {
+				wbuf[j] = out[0];
+				wbuf[pad + nwin + j] = out[nwin - 1];
+			} else {
+				wbuf[j] = xbuf[j];
+				wbuf[pad + nwin + j] = xbuf[pad + nwin + j];
+			}
+		}
+		nwin += 2 * pad;
+		if (rule == ENDRULE_MEDIAN) {
+			memcpy(xbuf, wbuf, sizeof(double) * nwin);
+			smooth_ends(xbuf, nwin, keff, wbuf, tmp);
+		}
+		if (int_ans) {
+			for (j = 0; j < nwin; j++) {
+				v = wbuf[j];
+				if (ISNAN(v)) {
+					INTEGER(ans)[ans_offset + j] =
+						NA_INTEGER;
+				} else if (v > INT_MAX || v < R_INT_MIN) {
+					overflow = 1;
+					INTEGER(ans)[ans_offset + j] =
+						NA_INTEGER;
+				} else {
+					INTEGER(ans)[ans_offset + j] = (int) v;
+				}
+			}
+		} else {
+			memcpy(REAL(ans) + ans_offset, wbuf,
+			       sizeof(double) * nwin);
+		}
+		ans_offset += nwin;
+	}
+	UNPROTECT(1);
+	if (overflow)
+		warning("NAs produced by integer overflow");
+	return ans;
+}
+
+/* --- .Call ENTRY POINT --- */
+SEXP C_runsum_CompressedAtomicList(SEXP x, SEXP k, SEXP endrule, SEXP na_rm)
+{
+	return grouped_run(x, k, RUN_SUM, R_NilValue, R_NilValue,
+			   endrule, na_rm);
+}
+
+/* --- .Call ENTRY POINT --- */
+SEXP C_runmean_CompressedAtomicList(SEXP x, SEXP k, SEXP endrule, SEXP na_rm)
+{
+	return grouped_run(x, k, RUN_MEAN, R_NilValue, R_NilValue,
+			   endrule, na_rm);
+}
+
+/* --- .Call ENTRY POINT --- */
+SEXP C_runwtsum_CompressedAtomicList(SEXP x, SEXP k, SEXP wt,
+		SEXP endrule, SEXP na_rm)
+{
+	return grouped_run(x, k, RUN_WTSUM, R_NilValue, wt, endrule, na_rm);
+}
+
+/* --- .Call ENTRY POINT --- */
+SEXP C_runq_CompressedAtomicList(SEXP x, SEXP k, SEXP i,
+		SEXP endrule, SEXP na_rm)
+{
+	return grouped_run(x, k, RUN_Q, i, R_NilValue, endrule, na_rm);
+}
+
+/* --- .Call ENTRY POINT --- */
+SEXP C_runmed_CompressedAtomicList(SEXP x, SEXP k, SEXP endrule)
+{
+	return grouped_run(x, k, RUN_MED, R_NilValue, R_NilValue,
+			   endrule, R_NilValue);
+}
+
+
+/****************************************************************************
+ * Grouped order(), rank(), selfmatch() and duplicated()
+ *
+ * Each list element is sorted on its own with a stable merge sort, instead
+ * of sorting the whole unlistData on (group, value) pairs. Only logical,
+ * integer and double data is supported.
+ */
+
+#define INSERTION_SORT_MAX	16
+
+/* The sort key of a value is its class (0 for non-NA values, 'na_class'
+   for NAs, and 2 * 'na_class' for NaNs when they must not tie with NAs)
+   followed by the value. */
+typedef struct element_keys_t {
+	double *val;
+	int *cls;
+	int desc;
+} ElementKeys;
+
+static int compar_keys(const ElementKeys *keys, int i, int j)
+{
+	if (keys->cls[i] != keys->cls[j])
+		return keys->cls[i] < keys->cls[j] ? -1 : 1;
+	if (keys->cls[i] != 0 || keys->val[i] == keys->val[j])
+		return 0;
+	return (keys->val[i] < keys->val[j]) != keys->desc ? -1 : 1;
+}
+
+/* Stable sort of 'idx[0..n-1]' on the keys: insertion sort of the blocks
+   of INSERTION_SORT_MAX indices, followed by bottom-up merging. */
+static void merge_sort_keys(int *idx, int n, int *tmp, const ElementKeys *keys)
+{
+	int lo, mid, hi, a, b, k, width, i0;
+	int *src, *dst, *swap;
+
+	for (lo = 0; lo < n; lo += INSERTION_SORT_MAX) {
+		hi = lo + INSERTION_SORT_MAX < n ? lo + INSERTION_SORT_MAX : n;
+		for (a = lo + 1; a < hi; a++) {
+			i0 = idx[a];
+			for (b = a; b > lo && compar_keys(keys, i0, idx[b - 1]) < 0;
+			     b--)
+				idx[b] = idx[b - 1];
+			idx[b] = i0;
+		}
+	}
+	src = idx;
+	dst = tmp;
+	for (width = INSERTION_SORT_MAX; width < n; width *= 2) {
+		for (lo = 0; lo < n; lo += 2 * width) {
+			mid = lo + width < n ? lo + width : n;
+			hi = lo + 2 * width < n ? lo + 2 * width : n;
+			if (mid == hi ||
+			    compar_keys(keys, src[mid], src[mid - 1]) >= 0)
+			{
+				/* Already in order. */
+				memcpy(dst + lo, src + lo, sizeof(int) * (hi - lo));
+				continue;
+			}
+			a = lo;
+			b = mid;
+			k = lo;
+			while (a < mid && b < hi)
+				dst[k++] = compar_keys(keys, src[b], src[a]) < 0 ?
+					   src[b++] : src[a++];
+			while (a < mid)
+				dst[k++] = src[a++];
+			while (b < hi)
+				dst[k++] = src[b++];
+		}
+		swap = src;
+		src = dst;
+		dst = swap;
+	}
+	if (src != idx)
+		memcpy(idx, src, sizeof(int) * n);
+	return;
+}
+
+/* Sets 'idx' to the stable order of the list element made of the 'n'
+   values starting at 'offset' in 'unlistData'. The order is made of local
+   0-based indices. Like with order(), the NAs go last if 'na_last' is TRUE,
+   first if it's FALSE, and are dropped if it's NA. Returns the length of
+   the order. */
+static int order_element(SEXP unlistData, int offset, int n,
+		int na_last, int distinct_nans, ElementKeys *keys,
+		int *idx, int *tmp)
+{
+	int na_class, j, nidx, iv;
+	double v;
+
+	na_class = na_last == 0 ? -1 : 1;
+	nidx = 0;
+	for (j = 0; j < n; j++) {
+		if (TYPEOF(unlistData) == REALSXP) {
+			v = REAL(unlistData)[offset + j];
+			keys->val[j] = v;
+			if (!ISNAN(v))
+				keys->cls[j] = 0;
+			else if (distinct_nans && !ISNA(v))
+				keys->cls[j] = 2 * na_class;
+			else
+				keys->cls[j] = na_class;
+		} else {
+			iv = INTEGER(unlistData)[offset + j];
+			keys->val[j] = (double) iv;
+			keys->cls[j] = iv == NA_INTEGER ? na_class : 0;
+		}
+		if (keys->cls[j] == 0 || na_last != NA_LOGICAL)
+			idx[nidx++] = j;
+	}
+	merge_sort_keys(idx, nidx, tmp, keys);
+	return nidx;
+}
+
+/* Allocates the buffers needed by order_element() for the longest list
+   element of 'x'. */
+static void alloc_order_buffers(const int *ends_p, int nends,
+		ElementKeys *keys, int **idx, int **tmp)
+{
+	int max_len, i, prev_end;
+
+	max_len = 0;
+	for (i = 0, prev_end = 0; i < nends; prev_end = ends_p[i], i++)
+		if (ends_p[i] - prev_end > max_len)
+			max_len = ends_p[i] - prev_end;
+	keys->val = (double *) R_alloc((long) max_len, sizeof(double));
+	keys->cls = (int *) R_alloc((long) max_len, sizeof(int));
+	*idx = (int *) R_alloc((long) max_len, sizeof(int));
+	*tmp = (int *) R_alloc((long) max_len, sizeof(int));
+	return;
+}
+
+/* --- .Call ENTRY POINT ---
+ * Returns the 1-based within-element order of each list element of 'x',
+ * unlisted. If 'global' is TRUE, the indices are positions in unlistData
+ * instead. */
+SEXP C_order_CompressedAtomicList(SEXP x, SEXP decreasing, SEXP na_last,
+		SEXP global)
+{
+	SEXP unlistData, ends, ans;
+	int nends, na_last0, is_global, i, j, prev_end, end, nidx, ans_len,
+	    *idx, *tmp;
+	const int *ends_p;
+	ElementKeys keys;
+
+	unlistData = _get_CompressedList_unlistData(x);
+	ends = _get_PartitioningByEnd_end(_get_CompressedList_partitioning(x));
+	nends = LENGTH(ends);
+	ends_p = INTEGER(ends);
+	keys.desc = asLogical(decreasing);
+	na_last0 = asLogical(na_last);
+	is_global = asLogical(global);
+	alloc_order_buffers(ends_p, nends, &keys, &idx, &tmp);
+	PROTECT(ans = NEW_INTEGER(LENGTH(unlistData)));
+	ans_len = 0;
+	for (i = 0, prev_end = 0; i < nends; i++, prev_end = end) {
+		end = ends_p[i];
+		nidx = order_element(unlistData, prev_end, end - prev_end,
+				     na_last0, 0, &keys, idx, tmp);
+		for (j = 0; j < nidx; j++)
+			INTEGER(ans)[ans_len++] = idx[j] + 1 +
+						  (is_global ? prev_end : 0);
+	}
+	if (ans_len != LENGTH(ans))
+		ans = lengthgets(ans, ans_len);
+	UNPROTECT(1);
+	return ans;
+}
+
+/* --- .Call ENTRY POINT ---
+ * Same as rank(na.last=TRUE) on each list element of 'x'. */
+SEXP C_rank_CompressedAtomicList(SEXP x, SEXP ties_method)
+{
+	SEXP unlistData, ends, ans;
+	int nends, i, j, k, run_end, prev_end, end, n, *idx, *tmp, *ans_p;
+	const int *ends_p;
+	const char *ties;
+	double *ans_d;
+	ElementKeys keys;
+
+	unlistData = _get_CompressedList_unlistData(x);
+	ends = _get_PartitioningByEnd_end(_get_CompressedList_partitioning(x));
+	nends = LENGTH(ends);
+	ends_p = INTEGER(ends);
+	ties = CHAR(STRING_ELT(ties_method, 0));
+	keys.desc = 0;
+	alloc_order_buffers(ends_p, nends, &keys, &idx, &tmp);
+	if (strcmp(ties, "average") == 0) {
+		PROTECT(ans = NEW_NUMERIC(LENGTH(unlistData)));
+		ans_d = REAL(ans);
+		ans_p = NULL;
+	} else {
+		PROTECT(ans = NEW_INTEGER(LENGTH(unlistData)));
+		ans_p = INTEGER(ans);
+		ans_d = NULL;
+	}
+	for (i = 0, prev_end = 0; i < nends; i++, prev_end = end) {
+		end = ends_p[i];
+		n = order_element(unlistData, prev_end, end - prev_end,
+				  1, 0, &keys, idx, tmp);
+		for (j = 0; j < n; j = run_end) {
+			/* The NAs get distinct ranks, in order of
+			   appearance. */
+			run_end = j + 1;
+			if (keys.cls[idx[j]] == 0)
+				while (run_end < n &&
+				       compar_keys(&keys, idx[j],
+						   idx[run_end]) == 0)
+					run_end++;
+			for (k = j; k < run_end; k++) {
+				/* The ties occupy the ranks j+1..run_end. */
+				if (ans_d != NULL) {
+					ans_d[prev_end + idx[k]] =
+						(j + 1 + run_end) / 2.0;
+				} else if (ties[0] == 'f') {  /* first */
+					ans_p[prev_end + idx[k]] = k + 1;
+				} else if (ties[0] == 'l') {  /* last */
+					ans_p[prev_end + idx[k]] =
+						run_end - (k - j);
+				} else if (strcmp(ties, "min") == 0) {
+					ans_p[prev_end + idx[k]] = j + 1;
+				} else {  /* max */
+					ans_p[prev_end + idx[k]] = run_end;
+				}
+			}
+		}
+	}
+	UNPROTECT(1);
+	return ans;
+}
+
+#define RUNS_TO_SELFMATCH	0
+#define RUNS_TO_DUPLICATED	1
+
+/* Walks the runs of identical values in each list element of 'x' (NA and
+   NaN are distinct values) and fills 'out' according to 'what':
+     RUNS_TO_SELFMATCH: Each value gets the 1-based position of the 1st
+         value of its run, which is its 1st occurrence since the sort is
+         stable. The position is global if 'flag' is TRUE, and relative to
+         the list element otherwise.
+     RUNS_TO_DUPLICATED: Each value gets FALSE if it's the 1st value of its
+         run (or the last if 'flag' is TRUE), and TRUE otherwise. */
+static void walk_identical_runs(SEXP x, int what, int flag, int *out)
+{
+	SEXP unlistData, ends;
+	int nends, i, j, k, run_end, prev_end, end, n, pos, *idx, *tmp;
+	const int *ends_p;
+	ElementKeys keys;
+
+	unlistData = _get_CompressedList_unlistData(x);
+	ends = _get_PartitioningByEnd_end(_get_CompressedList_partitioning(x));
+	nends = LENGTH(ends);
+	ends_p = INTEGER(ends);
+	keys.desc = 0;
+	alloc_order_buffers(ends_p, nends, &keys, &idx, &tmp);
+	for (i = 0, prev_end = 0; i < nends; i++, prev_end = end) {
+		end = ends_p[i];
+		n = order_element(unlistData, prev_end, end - prev_end,
+				  1, 1, &keys, idx, tmp);
+		for (j = 0; j < n; j = run_end) {
+			run_end = j + 1;
+			while (run_end < n &&
+			       compar_keys(&keys, idx[j], idx[run_end]) == 0)
+				run_end++;
+			for (k = j; k < run_end; k++) {
+				pos = prev_end + idx[k];
+				switch (what) {
+				    case RUNS_TO_SELFMATCH:
+					out[pos] = idx[j] + 1 +
+						   (flag ? prev_end : 0);
+					break;
+				    case RUNS_TO_DUPLICATED:
+					out[pos] = k != (flag ? run_end - 1
+							      : j);
+					break;
+				}
+			}
+		}
+	}
+	return;
+}
+
+/* --- .Call ENTRY POINT --- */
+SEXP C_selfmatch_CompressedAtomicList(SEXP x, SEXP global)
+{
+	SEXP ans;
+	int is_global, *ans_p;
+
+	is_global = asLogical(global);
+	PROTECT(ans = NEW_INTEGER(LENGTH(_get_CompressedList_unlistData(x))));
+	ans_p = INTEGER(ans);
+	walk_identical_runs(x, RUNS_TO_SELFMATCH, is_global, ans_p);
+	UNPROTECT(1);
+	return ans;
+}
+
+/* --- .Call ENTRY POINT --- */
+SEXP C_duplicated_CompressedAtomicList(SEXP x, SEXP fromLast)
+{
+	SEXP ans;
+	int from_last, *ans_p;
+
+	from_last = asLogical(fromLast);
+	PROTECT(ans = NEW_LOGICAL(LENGTH(_get_CompressedList_unlistData(x))));
+	ans_p = LOGICAL(ans);
+	walk_identical_runs(x, RUNS_TO_DUPLICATED, from_last, ans_p);
+	UNPROTECT(1);
+	return ans;
+}
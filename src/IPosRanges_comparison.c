@@ -62,42 +62,33 @@
  * checked). 'x_start' and 'y_start' must be 1-based. 'x_width' and 'y_width'
  * are assumed to be >= 0 (not checked).
  */
-int _overlap_code(int x_start, int x_width, int y_start, int y_width)
+/*
+ * The cascade of tests above is evaluated without branching: the code for
+ * overlapping ranges is 3 * sign(x_start - y_start) + sign(x_end - y_end),
+ * then the codes for non-overlapping ranges are blended in, from the least
+ * to the most prioritary. This makes the loops in _pcompare_ranges() below
+ * free of unpredictable branches and vectorizable by the compiler.
+ */
+static inline int overlap_code(int x_start, int x_width,
+			       int y_start, int y_width)
 {
-	int x_end_plus1, y_end_plus1;
+	int x_end_plus1, y_end_plus1, code;
 
 	x_end_plus1 = x_start + x_width;
-	if (x_end_plus1 < y_start)
-		return -6;
-	if (x_end_plus1 == y_start) {
-		if (x_width == 0 && y_width == 0)
-			return 0;
-		return -5;
-	}
 	y_end_plus1 = y_start + y_width;
-	if (y_end_plus1 < x_start)
-		return 6;
-	if (y_end_plus1 == x_start)
-		return 5;
-	if (x_start < y_start) {
-		if (x_end_plus1 < y_end_plus1)
-			return -4;
-		if (x_end_plus1 == y_end_plus1)
-			return -3;
-		return -2;
-	}
-	if (x_start == y_start) {
-		if (x_end_plus1 < y_end_plus1)
-			return -1;
-		if (x_end_plus1 == y_end_plus1)
-			return 0;
-		return 1;
-	}
-	if (x_end_plus1 < y_end_plus1)
-		return 2;
-	if (x_end_plus1 == y_end_plus1)
-		return 3;
-	return 4;
+	code = 3 * ((x_start > y_start) - (x_start < y_start)) +
+	       (x_end_plus1 > y_end_plus1) - (x_end_plus1 < y_end_plus1);
+	code = y_end_plus1 == x_start ? 5 : code;
+	code = y_end_plus1 < x_start ? 6 : code;
+	code = x_end_plus1 == y_start ? ((x_width | y_width) == 0 ? 0 : -5)
+				      : code;
+	code = x_end_plus1 < y_start ? -6 : code;
+	return code;
+}
+
+int _overlap_code(int x_start, int x_width, int y_start, int y_width)
+{
+	return overlap_code(x_start, x_width, y_start, y_width);
 }
 
 int _invert_overlap_code(int code)
@@ -110,28 +101,43 @@ int _invert_overlap_code(int code)
 	return code < 0 ? code + 4 : code - 4;
 }
 
-/* Vectorized comparison of 2 vectors of ranges. */
-static void pcompare_ranges(
+/* Vectorized comparison of 2 vectors of ranges. 'out_len' must be 0 if
+   'x_len' or 'y_len' is 0. Otherwise 'x' and 'y' are recycled to length
+   'out_len'. The common cases of no recycling and of a single range in 'y'
+   get their own loops.
+   The function does no allocation and has no global state, and out[k]
+   only depends on x[k] and y[k] when there is no recycling. So a caller
+   that has its own threads can run it on disjoint chunks of 'x', 'y' and
+   'out', and this function does not start threads itself. */
+void _pcompare_ranges(
 		const int *x_start, const int *x_width, int x_len,
 		const int *y_start, const int *y_width, int y_len,
-		int *out, int out_len, int with_warning)
+		int *out, int out_len)
 {
-	int i, j, k;
+	int i, j, k, y_start0, y_width0;
 
+	if (x_len == out_len && y_len == out_len) {
+		for (k = 0; k < out_len; k++)
+			out[k] = overlap_code(x_start[k], x_width[k],
+					      y_start[k], y_width[k]);
+		return;
+	}
+	if (x_len == out_len && y_len == 1) {
+		y_start0 = y_start[0];
+		y_width0 = y_width[0];
+		for (k = 0; k < out_len; k++)
+			out[k] = overlap_code(x_start[k], x_width[k],
+					      y_start0, y_width0);
+		return;
+	}
 	for (i = j = k = 0; k < out_len; i++, j++, k++) {
 		if (i >= x_len)
 			i = 0; /* recycle i */
 		if (j >= y_len)
 			j = 0; /* recycle j */
-		out[k] = _overlap_code(x_start[i], x_width[i],
-				       y_start[j], y_width[j]);
+		out[k] = overlap_code(x_start[i], x_width[i],
+				      y_start[j], y_width[j]);
 	}
-	/* This warning message is meaningful only when 'out_len' is
-           'max(x_len, y_len)' and is consistent with the warning we get from
-	   binary arithmetic/comparison operations on numeric vectors. */
-	if (with_warning && out_len != 0 && (i != x_len || j != y_len))
-		warning("longer object length is not a multiple "
-			"of shorter object length");
 	return;
 }
 
@@ -163,9 +169,285 @@ SEXP C_pcompare_IPosRanges(SEXP x_start, SEXP x_width,
 	else
 		ans_len = x_len >= y_len ? x_len : y_len;
 	PROTECT(ans = NEW_INTEGER(ans_len));
-	pcompare_ranges(x_start_p, x_width_p, x_len,
-		       y_start_p, y_width_p, y_len,
-		       INTEGER(ans), ans_len, 1);
+	_pcompare_ranges(x_start_p, x_width_p, x_len,
+			 y_start_p, y_width_p, y_len,
+			 INTEGER(ans), ans_len);
+	/* Consistent with the warning we get from binary arithmetic/comparison
+	   operations on numeric vectors. */
+	if (ans_len != 0 && (ans_len % x_len != 0 || ans_len % y_len != 0))
+		warning("longer object length is not a multiple "
+			"of shorter object length");
+	UNPROTECT(1);
+	return ans;
+}
+
+
+
+/****************************************************************************
+ * Matching against sorted ranges
+ *
+ * When the ranges in 'table' are sorted (i.e. by start first and then by
+ * width), the ranges in 'table' that are equal to a given range form a
+ * contiguous block and the 1st of them is found with a lower bound search.
+ * The search for x[i] starts from the lower bound found for x[i-1] and
+ * gallops forward (1, 2, 4, 8, ... steps) when x[i] >= x[i-1], so a sorted
+ * 'x' is matched in a single merge-like walk on 'x' and 'table' that costs
+ * O(M + N) when 'x' and 'table' have similar lengths, and O(M log(N/M))
+ * when 'x' is much shorter than 'table'. No hashing or sorting is involved
+ * and memory is accessed sequentially.
+ * The walk is not split across threads: the search for x[i] starts where
+ * the search for x[i-1] ended, and each step does a single comparison of
+ * 2 integer pairs per 8 bytes of 'table' read, so a big walk is limited by
+ * memory bandwidth rather than by the comparisons.
+ */
+
+static inline int compare_ranges(int start1, int width1,
+				 int start2, int width2)
+{
+	if (start1 != start2)
+		return start1 < start2 ? -1 : 1;
+	if (width1 != width2)
+		return width1 < width2 ? -1 : 1;
+	return 0;
+}
+
+static int ranges_are_sorted(const int *start, const int *width, int len,
+			     int desc)
+{
+	int i, c;
+
+	for (i = 1; i < len; i++) {
+		c = compare_ranges(start[i - 1], width[i - 1],
+				   start[i], width[i]);
+		if (desc ? c < 0 : c > 0)
+			return 0;
+	}
+	return 1;
+}
+
+/* Returns the index of the 1st range in [lo, hi) that is >= 'start' and
+   'width', or 'hi' if there is no such range. */
+static int lower_bound_range(const int *t_start, const int *t_width,
+			     int lo, int hi, int start, int width)
+{
+	int mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (compare_ranges(t_start[mid], t_width[mid], start, width) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/* Same as lower_bound_range(t_start, t_width, lo, t_len, start, width)
+   but finds the bounds of the binary search by galloping from 'lo'. */
+static int gallop_range(const int *t_start, const int *t_width, int t_len,
+			int lo, int start, int width)
+{
+	int step, probe, hi;
+
+	step = 1;
+	while (1) {
+		if (step > t_len - lo) {
+			hi = t_len;
+			break;
+		}
+		probe = lo + step - 1;
+		if (compare_ranges(t_start[probe], t_width[probe],
+				   start, width) >= 0)
+		{
+			hi = probe + 1;
+			break;
+		}
+		lo = probe + 1;
+		/* Same as 'step * 2 > t_len - lo' but cannot overflow. */
+		if (step > (t_len - lo) / 2) {
+			hi = t_len;
+			break;
+		}
+		step *= 2;
+	}
+	return lower_bound_range(t_start, t_width, lo, hi, start, width);
+}
+
+/* 'table' must be sorted. */
+static void match_ranges_in_sorted_table(
+		const int *x_start, const int *x_width, int x_len,
+		const int *t_start, const int *t_width, int t_len,
+		int nomatch, int *out)
+{
+	int i, j;
+
+	for (i = j = 0; i < x_len; i++) {
+		if (i != 0 && compare_ranges(x_start[i], x_width[i],
+					     x_start[i - 1], x_width[i - 1]) < 0)
+			j = lower_bound_range(t_start, t_width, 0, j,
+					      x_start[i], x_width[i]);
+		else
+			j = gallop_range(t_start, t_width, t_len, j,
+					 x_start[i], x_width[i]);
+		if (j < t_len && t_start[j] == x_start[i]
+			      && t_width[j] == x_width[i])
+			out[i] = j + 1;
+		else
+			out[i] = nomatch;
+	}
+	return;
+}
+
+/* --- .Call ENTRY POINT ---
+ * Returns NULL if the ranges in 'table' are not sorted.
+ */
+SEXP C_match_IPosRanges_in_sorted_table(SEXP x_start, SEXP x_width,
+		SEXP table_start, SEXP table_width, SEXP nomatch)
+{
+	int x_len, t_len;
+	const int *x_start_p, *x_width_p, *t_start_p, *t_width_p;
+	SEXP ans;
+
+	x_len = check_integer_pairs(x_start, x_width,
+				    &x_start_p, &x_width_p,
+				    "start(x)", "width(x)");
+	t_len = check_integer_pairs(table_start, table_width,
+				    &t_start_p, &t_width_p,
+				    "start(table)", "width(table)");
+	if (!ranges_are_sorted(t_start_p, t_width_p, t_len, 0))
+		return R_NilValue;
+	PROTECT(ans = NEW_INTEGER(x_len));
+	match_ranges_in_sorted_table(x_start_p, x_width_p, x_len,
+				     t_start_p, t_width_p, t_len,
+				     INTEGER(nomatch)[0], INTEGER(ans));
+	UNPROTECT(1);
+	return ans;
+}
+
+/* --- .Call ENTRY POINT ---
+ * Returns NULL if the ranges in 'x' are not sorted.
+ */
+SEXP C_selfmatch_sorted_IPosRanges(SEXP x_start, SEXP x_width)
+{
+	int x_len, i, first;
+	const int *x_start_p, *x_width_p;
+	int *ans_p;
+	SEXP ans;
+
+	x_len = check_integer_pairs(x_start, x_width,
+				    &x_start_p, &x_width_p,
+				    "start(x)", "width(x)");
+	if (!ranges_are_sorted(x_start_p, x_width_p, x_len, 0))
+		return R_NilValue;
+	PROTECT(ans = NEW_INTEGER(x_len));
+	ans_p = INTEGER(ans);
+	for (i = first = 0; i < x_len; i++) {
+		if (x_start_p[i] != x_start_p[first]
+		 || x_width_p[i] != x_width_p[first])
+			first = i;
+		ans_p[i] = first + 1;
+	}
+	UNPROTECT(1);
+	return ans;
+}
+
+
+/****************************************************************************
+ * Radix ordering
+ *
+ * Each range is turned into a 64-bit unsigned key where the start (with its
+ * sign bit flipped so that signed order becomes unsigned order) is in the
+ * upper 32 bits and the width (always >= 0) in the lower 32 bits. Comparing
+ * the keys is then equivalent to comparing the ranges with compare_ranges().
+ * The keys are sorted with a stable LSD radix sort on 16-bit digits. The
+ * histograms of the 4 digits are computed in a single pass over the keys,
+ * and the passes for digits that are the same for all the keys (e.g. the
+ * upper bits of the widths) are skipped.
+ * Decreasing order is obtained by sorting the complemented keys, which
+ * keeps ties in their original order, like base::order() does.
+ * The histogram phase is a single pass of increments into a 1 MB table of
+ * counts (4 x 65536 bins). Splitting it across threads would need one such
+ * table per thread and a merge of the tables, and the scatter passes that
+ * follow, which dominate, write to 65536 places at once and are bound by
+ * memory bandwidth.
+ */
+
+#define RADIX_BITS	16
+#define RADIX_NBIN	(1 << RADIX_BITS)
+#define RADIX_NPASS	(64 / RADIX_BITS)
+#define RADIX_DIGIT(key, pass) \
+	((int) (((key) >> ((pass) * RADIX_BITS)) & (RADIX_NBIN - 1)))
+
+typedef unsigned long long int RangeKey;
+
+static inline RangeKey make_range_key(int start, int width)
+{
+	return ((RangeKey) ((unsigned int) start ^ 0x80000000U) << 32) |
+	       (RangeKey) (unsigned int) width;
+}
+
+/* 'out' must have room for 'len' elements. Stores 1-based indices. */
+static void radix_order_ranges(const int *start, const int *width, int len,
+			       int desc, int *out)
+{
+	RangeKey *key, *key2, *tmp_key, k;
+	int *idx, *idx2, *tmp_idx, *count, *bins, i, pass, b, sum, c;
+
+	if (ranges_are_sorted(start, width, len, desc)) {
+		for (i = 0; i < len; i++)
+			out[i] = i + 1;
+		return;
+	}
+	key = (RangeKey *) R_alloc((long) len, sizeof(RangeKey));
+	key2 = (RangeKey *) R_alloc((long) len, sizeof(RangeKey));
+	idx2 = (int *) R_alloc((long) len, sizeof(int));
+	count = (int *) R_alloc((long) RADIX_NPASS * RADIX_NBIN, sizeof(int));
+	memset(count, 0, sizeof(int) * RADIX_NPASS * RADIX_NBIN);
+	idx = out;
+	for (i = 0; i < len; i++) {
+		k = make_range_key(start[i], width[i]);
+		if (desc)
+			k = ~k;
+		key[i] = k;
+		idx[i] = i + 1;
+		for (pass = 0; pass < RADIX_NPASS; pass++)
+			count[pass * RADIX_NBIN + RADIX_DIGIT(k, pass)]++;
+	}
+	for (pass = 0; pass < RADIX_NPASS; pass++) {
+		bins = count + pass * RADIX_NBIN;
+		if (bins[RADIX_DIGIT(key[0], pass)] == len)
+			continue;  /* all the keys have the same digit */
+		for (b = sum = 0; b < RADIX_NBIN; b++) {
+			c = bins[b];
+			bins[b] = sum;
+			sum += c;
+		}
+		for (i = 0; i < len; i++) {
+			c = bins[RADIX_DIGIT(key[i], pass)]++;
+			key2[c] = key[i];
+			idx2[c] = idx[i];
+		}
+		tmp_key = key; key = key2; key2 = tmp_key;
+		tmp_idx = idx; idx = idx2; idx2 = tmp_idx;
+	}
+	if (idx != out)
+		memcpy(out, idx, sizeof(int) * len);
+	return;
+}
+
+/* --- .Call ENTRY POINT --- */
+SEXP C_radix_order_IPosRanges(SEXP x_start, SEXP x_width, SEXP decreasing)
+{
+	int x_len;
+	const int *x_start_p, *x_width_p;
+	SEXP ans;
+
+	x_len = check_integer_pairs(x_start, x_width,
+				    &x_start_p, &x_width_p,
+				    "start(x)", "width(x)");
+	PROTECT(ans = NEW_INTEGER(x_len));
+	radix_order_ranges(x_start_p, x_width_p, x_len,
+			   LOGICAL(decreasing)[0], INTEGER(ans));
 	UNPROTECT(1);
 	return ans;
 }
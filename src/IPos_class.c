@@ -0,0 +1,314 @@
+/****************************************************************************
+ *               Low-level manipulation of StitchedIPos objects             *
+ ****************************************************************************/
+#include "IRanges.h"
+#include "S4Vectors_interface.h"
+
+#include <limits.h>  /* for INT_MAX */
+
+
+/****************************************************************************
+ * Stitching
+ *
+ * 2 consecutive ranges x[i] and x[i+1] are "stitchable" if
+ * start(x[i+1]) == end(x[i]) + 1. See stitch_IntegerRanges() in
+ * R/IPos-class.R for the details.
+ * Both passes below walk 'x' in the same way: the 1st pass counts the runs
+ * of stitchable ranges, the 2nd pass fills the preallocated result. No
+ * buffer proportional to the length of 'x' is needed.
+ */
+
+/* If 'drop_empty_ranges' is TRUE, the empty ranges in 'x' are ignored i.e.
+   they don't break runs and they don't produce empty runs. Note that,
+   when 'x' is made of runs of positions, stitching after dropping the empty
+   ranges can produce less runs than dropping the empty runs after stitching.
+   Returns the number of runs. 'out_start' and 'out_width' can be NULL. */
+static int stitch_ranges(const int *x_start, const int *x_width, int x_len,
+		int drop_empty_ranges, int *out_start, int *out_width)
+{
+	int out_len, i, start, width, run_end;
+
+	out_len = 0;
+	run_end = 0;
+	for (i = 0; i < x_len; i++) {
+		start = x_start[i];
+		width = x_width[i];
+		if (drop_empty_ranges && width == 0)
+			continue;
+		if (out_len != 0 && start - 1 == run_end) {
+			if (out_width != NULL) {
+				if (out_width[out_len - 1] > INT_MAX - width)
+					error("stitching would produce a range "
+					      "with a width greater than "
+					      ".Machine$integer.max");
+				out_width[out_len - 1] += width;
+			}
+		} else {
+			if (out_start != NULL) {
+				out_start[out_len] = start;
+				out_width[out_len] = width;
+			}
+			out_len++;
+		}
+		run_end = start + width - 1;
+	}
+	return out_len;
+}
+
+/* --- .Call ENTRY POINT --- */
+SEXP C_stitch_IntegerRanges(SEXP x_start, SEXP x_width,
+		SEXP drop_empty_ranges)
+{
+	int x_len, drop, ans_len;
+	const int *x_start_p, *x_width_p;
+	SEXP ans, ans_start, ans_width;
+
+	x_len = check_integer_pairs(x_start, x_width,
+				    &x_start_p, &x_width_p,
+				    "start(x)", "width(x)");
+	drop = LOGICAL(drop_empty_ranges)[0];
+	ans_len = stitch_ranges(x_start_p, x_width_p, x_len, drop, NULL, NULL);
+	PROTECT(ans_start = NEW_INTEGER(ans_len));
+	PROTECT(ans_width = NEW_INTEGER(ans_len));
+	stitch_ranges(x_start_p, x_width_p, x_len, drop,
+		      INTEGER(ans_start), INTEGER(ans_width));
+	PROTECT(ans = _new_IRanges("IRanges", ans_start, ans_width,
+				   R_NilValue));
+	UNPROTECT(3);
+	return ans;
+}
+
+
+/****************************************************************************
+ * Unstitching
+ */
+
+/* --- .Call ENTRY POINT ---
+ * Expands the runs of positions described by 'x_start' and 'x_width' into
+ * a vector of positions.
+ */
+SEXP C_unstitch_IntegerRanges(SEXP x_start, SEXP x_width)
+{
+	int x_len, i, start, width, j;
+	const int *x_start_p, *x_width_p;
+	long long int ans_len;
+	int *ans_p;
+	SEXP ans;
+
+	x_len = check_integer_pairs(x_start, x_width,
+				    &x_start_p, &x_width_p,
+				    "start(x)", "width(x)");
+	ans_len = 0;
+	for (i = 0; i < x_len; i++)
+		ans_len += x_width_p[i];
+	if (ans_len > INT_MAX)
+		error("too many positions");
+	PROTECT(ans = NEW_INTEGER((int) ans_len));
+	ans_p = INTEGER(ans);
+	for (i = 0; i < x_len; i++) {
+		start = x_start_p[i];
+		width = x_width_p[i];
+		for (j = 0; j < width; j++)
+			*(ans_p++) = start + j;
+	}
+	UNPROTECT(1);
+	return ans;
+}
+
+
+/****************************************************************************
+ * Positional access
+ *
+ * The positions in a StitchedIPos object are accessed through the offsets
+ * of its runs i.e. 'offsets[k]' is the number of positions before run k.
+ * This gives O(log r) random access to a position, where r is the number
+ * of runs, and O(1) access when positions are walked in order.
+ */
+
+/* Returns 'offsets' and sets '*npos' to the total number of positions. */
+static int *get_run_offsets(const int *run_width, int nrun, int *npos)
+{
+	int *offsets, k;
+	long long int offset;
+
+	offsets = (int *) R_alloc((long) nrun + 1, sizeof(int));
+	offset = 0;
+	for (k = 0; k < nrun; k++) {
+		offsets[k] = (int) offset;
+		offset += run_width[k];
+		if (offset > INT_MAX)
+			error("too many positions");
+	}
+	offsets[nrun] = (int) offset;
+	*npos = (int) offset;
+	return offsets;
+}
+
+/* Returns the index of the run that contains the position at 0-based
+   index 'i'. 'k' is a hint i.e. the run of the previously accessed
+   position. */
+static int find_run(const int *offsets, int nrun, int i, int k)
+{
+	int lo, hi, mid;
+
+	if (k < nrun && offsets[k] <= i) {
+		if (i < offsets[k + 1])
+			return k;
+		if (k + 1 < nrun && i < offsets[k + 2])
+			return k + 1;
+	}
+	/* Binary search for the last run with an offset <= i. */
+	lo = 0;
+	hi = nrun - 1;
+	while (lo < hi) {
+		mid = lo + (hi - lo + 1) / 2;
+		if (offsets[mid] <= i)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+	return lo;
+}
+
+/* --- .Call ENTRY POINT ---
+ * 'idx' must be an integer vector of valid 1-based indices into the
+ * positions described by runs 'run_start' and 'run_width'.
+ * Returns the positions at these indices.
+ */
+SEXP C_get_pos_from_runs(SEXP run_start, SEXP run_width, SEXP idx)
+{
+	int nrun, npos, idx_len, n, i, k;
+	const int *run_start_p, *run_width_p, *idx_p, *offsets;
+	int *ans_p;
+	SEXP ans;
+
+	nrun = check_integer_pairs(run_start, run_width,
+				   &run_start_p, &run_width_p,
+				   "start(pos_runs)", "width(pos_runs)");
+	offsets = get_run_offsets(run_width_p, nrun, &npos);
+	idx_len = LENGTH(idx);
+	idx_p = INTEGER(idx);
+	PROTECT(ans = NEW_INTEGER(idx_len));
+	ans_p = INTEGER(ans);
+	for (n = k = 0; n < idx_len; n++) {
+		i = idx_p[n];
+		if (i == NA_INTEGER || i < 1 || i > npos) {
+			UNPROTECT(1);
+			error("subscript contains NAs or out-of-bounds indices");
+		}
+		i--;
+		k = find_run(offsets, nrun, i, k);
+		ans_p[n] = run_start_p[k] + (i - offsets[k]);
+	}
+	UNPROTECT(1);
+	return ans;
+}
+
+
+/****************************************************************************
+ * findOverlaps() between integer ranges and a StitchedIPos object
+ *
+ * The overlaps are first found between the query and the runs of positions
+ * of the subject. Each hit between a query range and a run is then expanded
+ * into the hits between the query range and the positions in the run. This
+ * is only valid for "any" overlaps with 'minoverlap' set to 0, in which case
+ * position p overlaps with query range [s, e] if and only if
+ *     s - (maxgap + 1) <= p <= e + (maxgap + 1).
+ */
+
+static void get_overlapping_pos(int q_start, int q_end, int slack,
+		int run_start, int run_end, int *first, int *last)
+{
+	long long int lo, hi;
+
+	lo = (long long int) q_start - slack;
+	hi = (long long int) q_end + slack;
+	*first = lo > run_start ? (int) lo : run_start;
+	*last = hi < run_end ? (int) hi : run_end;
+}
+
+/* --- .Call ENTRY POINT ---
+ * Args:
+ *   q_hits, run_hits: The hits between the query and the runs of positions
+ *                     of the subject, sorted by query.
+ *   q_start, q_end:   The query ranges.
+ *   run_start,
+ *   run_width:        The runs of positions of the subject.
+ *   maxgap:           A single integer >= -1.
+ * Returns a SortedByQueryHits object where the hits are also sorted by
+ * subject within each query.
+ */
+SEXP C_map_run_hits_to_pos(SEXP q_hits, SEXP run_hits,
+		SEXP q_start, SEXP q_end,
+		SEXP run_start, SEXP run_width, SEXP maxgap)
+{
+	int nhit0, q_len, nrun, npos, slack, h, g, k, q, first, last, p;
+	const int *q_hits_p, *run_hits_p, *q_start_p, *q_end_p,
+		  *run_start_p, *run_width_p, *offsets;
+	int *sorted_run_hits, *ans_from, *ans_to;
+	long long int nhit;
+
+	nhit0 = LENGTH(q_hits);
+	q_hits_p = INTEGER(q_hits);
+	run_hits_p = INTEGER(run_hits);
+	q_len = check_integer_pairs(q_start, q_end,
+				    &q_start_p, &q_end_p,
+				    "start(query)", "end(query)");
+	nrun = check_integer_pairs(run_start, run_width,
+				   &run_start_p, &run_width_p,
+				   "start(pos_runs)", "width(pos_runs)");
+	offsets = get_run_offsets(run_width_p, nrun, &npos);
+	slack = INTEGER(maxgap)[0] + 1;
+
+	/* Sort the runs within each query so the expanded hits come out
+	   sorted by subject within each query. */
+	sorted_run_hits = (int *) R_alloc((long) nhit0 + 1, sizeof(int));
+	memcpy(sorted_run_hits, run_hits_p, sizeof(int) * nhit0);
+	for (h = 0; h < nhit0; h = g) {
+		for (g = h + 1; g < nhit0 && q_hits_p[g] == q_hits_p[h]; g++) {}
+		if (g - h >= 2)
+			sort_int_array(sorted_run_hits + h, g - h, 0);
+	}
+
+	/* 1st pass: count the hits. */
+	nhit = 0;
+	for (h = 0; h < nhit0; h++) {
+		q = q_hits_p[h] - 1;
+		k = sorted_run_hits[h] - 1;
+		get_overlapping_pos(q_start_p[q], q_end_p[q], slack,
+				    run_start_p[k],
+				    run_start_p[k] + run_width_p[k] - 1,
+				    &first, &last);
+		if (first <= last)
+			nhit += (long long int) last - first + 1;
+	}
+	if (nhit > INT_MAX)
+		error("too many hits");
+
+	/* 2nd pass: fill the hits. */
+	ans_from = (int *) R_alloc((long) nhit + 1, sizeof(int));
+	ans_to = (int *) R_alloc((long) nhit + 1, sizeof(int));
+	nhit = 0;
+	for (h = 0; h < nhit0; h++) {
+		q = q_hits_p[h] - 1;
+		k = sorted_run_hits[h] - 1;
+		get_overlapping_pos(q_start_p[q], q_end_p[q], slack,
+				    run_start_p[k],
+				    run_start_p[k] + run_width_p[k] - 1,
+				    &first, &last);
+		if (first > last)
+			continue;
+		/* Not using 'p <= last' as the loop condition because 'p++'
+		   could overflow when 'last' is INT_MAX. */
+		for (p = first; ; p++) {
+			ans_from[nhit] = q + 1;
+			ans_to[nhit] = offsets[k] + (p - run_start_p[k]) + 1;
+			nhit++;
+			if (p == last)
+				break;
+		}
+	}
+	return new_Hits("SortedByQueryHits", ans_from, ans_to, (int) nhit,
+			q_len, npos, 1);
+}
+
@@ -30,6 +30,17 @@ int _invert_overlap_code(
 	int code
 );
 
+void _pcompare_ranges(
+	const int *x_start,
+	const int *x_width,
+	int x_len,
+	const int *y_start,
+	const int *y_width,
+	int y_len,
+	int *out,
+	int out_len
+);
+
 SEXP C_pcompare_IPosRanges(
 	SEXP x_start,
 	SEXP x_width,
@@ -37,6 +48,25 @@ SEXP C_pcompare_IPosRanges(
 	SEXP y_width
 );
 
+SEXP C_match_IPosRanges_in_sorted_table(
+	SEXP x_start,
+	SEXP x_width,
+	SEXP table_start,
+	SEXP table_width,
+	SEXP nomatch
+);
+
+SEXP C_selfmatch_sorted_IPosRanges(
+	SEXP x_start,
+	SEXP x_width
+);
+
+SEXP C_radix_order_IPosRanges(
+	SEXP x_start,
+	SEXP x_width,
+	SEXP decreasing
+);
+
 
 /* IRanges_class.c */
 
@@ -110,6 +140,17 @@ SEXP _alloc_IRanges(
 	int length
 );
 
+void _init_external_buffer_classes(DllInfo *info);
+
+SEXP _new_IRanges_from_external_buffers(
+	const char *classname,
+	const int *start,
+	const int *width,
+	int length,
+	int writable,
+	SEXP owner
+);
+
 int _is_normal_IRanges_holder(const IRanges_holder *x_holder);
 
 SEXP C_isNormal_IRanges(SEXP x);
@@ -119,6 +160,36 @@ SEXP C_from_integer_to_IRanges(SEXP x);
 SEXP C_from_logical_to_NormalIRanges(SEXP x);
 
 
+/* IPos_class.c */
+
+SEXP C_stitch_IntegerRanges(
+	SEXP x_start,
+	SEXP x_width,
+	SEXP drop_empty_ranges
+);
+
+SEXP C_unstitch_IntegerRanges(
+	SEXP x_start,
+	SEXP x_width
+);
+
+SEXP C_get_pos_from_runs(
+	SEXP run_start,
+	SEXP run_width,
+	SEXP idx
+);
+
+SEXP C_map_run_hits_to_pos(
+	SEXP q_hits,
+	SEXP run_hits,
+	SEXP q_start,
+	SEXP q_end,
+	SEXP run_start,
+	SEXP run_width,
+	SEXP maxgap
+);
+
+
 /* IRanges_constructor.c */
 
 SEXP C_solve_user_SEW0(
@@ -196,6 +267,27 @@ SEXP C_viewWhichMaxs_RleViews(
 	SEXP na_rm
 );
 
+SEXP C_viewSummaries_RleViews(
+	SEXP x,
+	SEXP stats,
+	SEXP na_rm
+);
+
+SEXP C_viewSummary_RleViewsList(
+	SEXP x_listData,
+	SEXP summary,
+	SEXP na_rm
+);
+
+SEXP C_viewApply_RleViews(
+	SEXP x,
+	SEXP kernel,
+	SEXP probs,
+	SEXP threshold,
+	SEXP w,
+	SEXP na_rm
+);
+
 
 /* SimpleIRangesList_class.c */
 
@@ -274,6 +366,41 @@ SEXP C_max_CompressedNormalIRangesList(
 );
 
 
+/* intra_range_methods.c */
+
+SEXP C_restrict_ranges(
+	SEXP x_start,
+	SEXP x_width,
+	SEXP start,
+	SEXP end,
+	SEXP drop_ranges_mode,
+	SEXP breakpoints
+);
+
+SEXP C_resize_ranges(
+	SEXP x_start,
+	SEXP x_width,
+	SEXP width,
+	SEXP fix_lengths,
+	SEXP fix_codes
+);
+
+SEXP C_flank_ranges(
+	SEXP x_start,
+	SEXP x_width,
+	SEXP width,
+	SEXP start,
+	SEXP both
+);
+
+SEXP C_promoters_ranges(
+	SEXP x_start,
+	SEXP x_width,
+	SEXP upstream,
+	SEXP downstream
+);
+
+
 /* inter_range_methods.c */
 
 SEXP C_range_IRanges(SEXP x);
@@ -294,6 +421,15 @@ SEXP C_reduce_CompressedIRangesList(
 	SEXP with_revmap
 );
 
+SEXP C_reduce_sorted_chunk(
+	SEXP x_start,
+	SEXP x_width,
+	SEXP state,
+	SEXP drop_empty_ranges,
+	SEXP min_gapwidth,
+	SEXP flush
+);
+
 SEXP C_gaps_IntegerRanges(
 	SEXP x_start,
 	SEXP x_width,
@@ -307,12 +443,44 @@ SEXP C_gaps_CompressedIRangesList(
 	SEXP end
 );
 
+SEXP C_setop_IntegerRanges(
+	SEXP x_start,
+	SEXP x_width,
+	SEXP y_start,
+	SEXP y_width,
+	SEXP op
+);
+
+SEXP C_setop_CompressedIRangesList(
+	SEXP x,
+	SEXP y,
+	SEXP op
+);
+
 SEXP C_disjointBins_IntegerRanges(
 	SEXP x_start,
 	SEXP x_width
 );
 
 
+/* slice_methods.c */
+
+SEXP C_slice_Rle(
+	SEXP x,
+	SEXP lower,
+	SEXP upper,
+	SEXP includeLower,
+	SEXP includeUpper,
+	SEXP with_summaries
+);
+
+SEXP C_multislice_Rle(
+	SEXP x,
+	SEXP thresholds,
+	SEXP includeLower
+);
+
+
 /* coverage_methods.c */
 
 SEXP C_coverage_IRanges(
@@ -461,6 +629,21 @@ SEXP C_which_max_CompressedIntegerList(SEXP x);
 
 SEXP C_which_max_CompressedNumericList(SEXP x);
 
+SEXP C_range_with_which_CompressedLogicalList(
+	SEXP x,
+	SEXP na_rm
+);
+
+SEXP C_range_with_which_CompressedIntegerList(
+	SEXP x,
+	SEXP na_rm
+);
+
+SEXP C_range_with_which_CompressedNumericList(
+	SEXP x,
+	SEXP na_rm
+);
+
 SEXP C_is_unsorted_CompressedLogicalList(
 	SEXP x,
 	SEXP na_rm,
@@ -479,6 +662,184 @@ SEXP C_is_unsorted_CompressedNumericList(
 	SEXP strictly
 );
 
+SEXP C_mean_CompressedLogicalList(
+	SEXP x,
+	SEXP na_rm
+);
+
+SEXP C_mean_CompressedIntegerList(
+	SEXP x,
+	SEXP na_rm
+);
+
+SEXP C_mean_CompressedNumericList(
+	SEXP x,
+	SEXP na_rm
+);
+
+SEXP C_var_CompressedLogicalList(
+	SEXP x,
+	SEXP na_rm
+);
+
+SEXP C_var_CompressedIntegerList(
+	SEXP x,
+	SEXP na_rm
+);
+
+SEXP C_var_CompressedNumericList(
+	SEXP x,
+	SEXP na_rm
+);
+
+SEXP C_median_CompressedLogicalList(
+	SEXP x,
+	SEXP na_rm
+);
+
+SEXP C_median_CompressedIntegerList(
+	SEXP x,
+	SEXP na_rm
+);
+
+SEXP C_median_CompressedNumericList(
+	SEXP x,
+	SEXP na_rm
+);
+
+SEXP C_mad_CompressedLogicalList(
+	SEXP x,
+	SEXP na_rm
+);
+
+SEXP C_mad_CompressedIntegerList(
+	SEXP x,
+	SEXP na_rm
+);
+
+SEXP C_mad_CompressedNumericList(
+	SEXP x,
+	SEXP na_rm
+);
+
+SEXP C_quantile_CompressedLogicalList(
+	SEXP x,
+	SEXP probs,
+	SEXP na_rm
+);
+
+SEXP C_quantile_CompressedIntegerList(
+	SEXP x,
+	SEXP probs,
+	SEXP na_rm
+);
+
+SEXP C_quantile_CompressedNumericList(
+	SEXP x,
+	SEXP probs,
+	SEXP na_rm
+);
+
+SEXP C_cumsum_CompressedLogicalList(SEXP x);
+
+SEXP C_cumsum_CompressedIntegerList(SEXP x);
+
+SEXP C_cumsum_CompressedNumericList(SEXP x);
+
+SEXP C_cumprod_CompressedLogicalList(SEXP x);
+
+SEXP C_cumprod_CompressedIntegerList(SEXP x);
+
+SEXP C_cumprod_CompressedNumericList(SEXP x);
+
+SEXP C_cummin_CompressedLogicalList(SEXP x);
+
+SEXP C_cummin_CompressedIntegerList(SEXP x);
+
+SEXP C_cummin_CompressedNumericList(SEXP x);
+
+SEXP C_cummax_CompressedLogicalList(SEXP x);
+
+SEXP C_cummax_CompressedIntegerList(SEXP x);
+
+SEXP C_cummax_CompressedNumericList(SEXP x);
+
+SEXP C_diff_CompressedLogicalList(
+	SEXP x,
+	SEXP lag,
+	SEXP differences
+);
+
+SEXP C_diff_CompressedIntegerList(
+	SEXP x,
+	SEXP lag,
+	SEXP differences
+);
+
+SEXP C_diff_CompressedNumericList(
+	SEXP x,
+	SEXP lag,
+	SEXP differences
+);
+
+SEXP C_runsum_CompressedAtomicList(
+	SEXP x,
+	SEXP k,
+	SEXP endrule,
+	SEXP na_rm
+);
+
+SEXP C_runmean_CompressedAtomicList(
+	SEXP x,
+	SEXP k,
+	SEXP endrule,
+	SEXP na_rm
+);
+
+SEXP C_runwtsum_CompressedAtomicList(
+	SEXP x,
+	SEXP k,
+	SEXP wt,
+	SEXP endrule,
+	SEXP na_rm
+);
+
+SEXP C_runq_CompressedAtomicList(
+	SEXP x,
+	SEXP k,
+	SEXP i,
+	SEXP endrule,
+	SEXP na_rm
+);
+
+SEXP C_runmed_CompressedAtomicList(
+	SEXP x,
+	SEXP k,
+	SEXP endrule
+);
+
+SEXP C_order_CompressedAtomicList(
+	SEXP x,
+	SEXP decreasing,
+	SEXP na_last,
+	SEXP global
+);
+
+SEXP C_rank_CompressedAtomicList(
+	SEXP x,
+	SEXP ties_method
+);
+
+SEXP C_selfmatch_CompressedAtomicList(
+	SEXP x,
+	SEXP global
+);
+
+SEXP C_duplicated_CompressedAtomicList(
+	SEXP x,
+	SEXP fromLast
+);
+
 /* extractListFragments.c */
 
 SEXP C_find_partition_overlaps(
@@ -5,6 +5,12 @@
 #include "IRanges.h"
 #include "S4Vectors_interface.h"
 
+#include <Rversion.h>
+#if R_VERSION >= R_Version(3, 6, 0)
+#define HAVE_ALTREP
+#include <R_ext/Altrep.h>
+#endif
+
 
 /****************************************************************************
  * C-level slot getters.
@@ -253,10 +259,196 @@ SEXP _alloc_IRanges(const char *classname, int length)
 }
 
 
+/****************************************************************************
+ * IRanges objects over externally owned memory.
+ *
+ * The "start" and "width" slots of the IRanges object returned by
+ * _new_IRanges_from_external_buffers() are ALTREP integer vectors that
+ * point directly at the supplied buffers (e.g. columns of a mmap'ed file).
+ * Nothing is copied and the buffers are not read until the data is actually
+ * accessed.
+ * The data1 field of each ALTREP vector is an external pointer to the
+ * buffer. Its 'prot' field holds the 'owner' object supplied by the caller
+ * (typically an external pointer with a finalizer that releases the memory)
+ * so the memory stays alive for as long as the ALTREP vector is alive. Its
+ * 'tag' field holds the length of the buffer and whether it's writable.
+ * INTEGER() always requests write access, even when the caller only reads
+ * the data, so a read-only buffer is copied into the data2 field of the
+ * ALTREP vector the 1st time INTEGER() is called on it. Most C code reads
+ * integer vectors with INTEGER(), including C_validate_Ranges() and most of
+ * the .Call entry points of IRanges, so in practice the copy happens the
+ * 1st time the object is validated or passed to compiled code. Element
+ * access from R, INTEGER_RO(), and INTEGER_GET_REGION() don't copy.
+ * A writable buffer is never copied: INTEGER() returns a pointer to the
+ * caller's buffer and C code can write into it.
+ * With versions of R that don't support ALTREP, the buffers are copied.
+ */
+
+#ifdef HAVE_ALTREP
+
+static R_altrep_class_t extbuf_integer_class;
+
+static SEXP new_extbuf_integer(const int *buf, int length, int writable,
+			       SEXP owner)
+{
+	SEXP info, xp, ans;
+
+	PROTECT(info = NEW_INTEGER(2));
+	INTEGER(info)[0] = length;
+	INTEGER(info)[1] = writable;
+	PROTECT(xp = R_MakeExternalPtr((void *) buf, info, owner));
+	ans = R_new_altrep(extbuf_integer_class, xp, R_NilValue);
+	UNPROTECT(2);
+	return ans;
+}
+
+static const int *get_extbuf_ptr(SEXP x)
+{
+	SEXP copy;
+
+	copy = R_altrep_data2(x);
+	if (copy != R_NilValue)
+		return INTEGER(copy);
+	return (const int *) R_ExternalPtrAddr(R_altrep_data1(x));
+}
+
+static R_xlen_t extbuf_Length(SEXP x)
+{
+	return INTEGER(R_ExternalPtrTag(R_altrep_data1(x)))[0];
+}
+
+static void *extbuf_Dataptr(SEXP x, Rboolean writeable)
+{
+	SEXP copy;
+	int length;
+
+	if (!writeable || R_altrep_data2(x) != R_NilValue ||
+	    INTEGER(R_ExternalPtrTag(R_altrep_data1(x)))[1])
+		return (void *) get_extbuf_ptr(x);
+	length = (int) extbuf_Length(x);
+	PROTECT(copy = NEW_INTEGER(length));
+	memcpy(INTEGER(copy), get_extbuf_ptr(x), sizeof(int) * length);
+	R_set_altrep_data2(x, copy);
+	UNPROTECT(1);
+	return INTEGER(copy);
+}
+
+static const void *extbuf_Dataptr_or_null(SEXP x)
+{
+	return get_extbuf_ptr(x);
+}
+
+static int extbuf_Elt(SEXP x, R_xlen_t i)
+{
+	return get_extbuf_ptr(x)[i];
+}
+
+static R_xlen_t extbuf_Get_region(SEXP x, R_xlen_t i, R_xlen_t n, int *buf)
+{
+	R_xlen_t length;
+
+	length = extbuf_Length(x);
+	if (n > length - i)
+		n = length - i;
+	if (n <= 0)
+		return 0;
+	memcpy(buf, get_extbuf_ptr(x) + i, sizeof(int) * n);
+	return n;
+}
+
+/* The start and width of valid ranges are never NA. */
+static int extbuf_No_NA(SEXP x)
+{
+	return 1;
+}
+
+static Rboolean extbuf_Inspect(SEXP x, int pre, int deep, int pvec,
+		void (*inspect_subtree)(SEXP, int, int, int))
+{
+	Rprintf(" IRanges external buffer (len=%d, %s)\n",
+		(int) extbuf_Length(x),
+		R_altrep_data2(x) != R_NilValue ? "copied" : "not copied");
+	return TRUE;
+}
+
+#else
+
+static SEXP new_extbuf_integer(const int *buf, int length, int writable,
+			       SEXP owner)
+{
+	SEXP ans;
+
+	ans = NEW_INTEGER(length);
+	memcpy(INTEGER(ans), buf, sizeof(int) * length);
+	return ans;
+}
+
+#endif
+
+void _init_external_buffer_classes(DllInfo *info)
+{
+#ifdef HAVE_ALTREP
+	extbuf_integer_class = R_make_altinteger_class("extbuf_integer",
+						       "IRanges", info);
+	R_set_altrep_Length_method(extbuf_integer_class, extbuf_Length);
+	R_set_altrep_Inspect_method(extbuf_integer_class, extbuf_Inspect);
+	R_set_altvec_Dataptr_method(extbuf_integer_class, extbuf_Dataptr);
+	R_set_altvec_Dataptr_or_null_method(extbuf_integer_class,
+					    extbuf_Dataptr_or_null);
+	R_set_altinteger_Elt_method(extbuf_integer_class, extbuf_Elt);
+	R_set_altinteger_Get_region_method(extbuf_integer_class,
+					   extbuf_Get_region);
+	R_set_altinteger_No_NA_method(extbuf_integer_class, extbuf_No_NA);
+#endif
+	return;
+}
+
+/* 'start' and 'width' must describe valid ranges (this is not checked, so
+   the buffers are not read) and must stay valid for as long as 'owner' is
+   alive. 'owner' can be R_NilValue if the buffers are never released. If
+   'writable' is 0, the buffers are never written to but are copied the 1st
+   time INTEGER() is called on the "start" or "width" slot. Otherwise C code
+   that calls INTEGER() on these slots gets the buffers themselves and can
+   modify them. */
+SEXP _new_IRanges_from_external_buffers(const char *classname,
+		const int *start, const int *width, int length,
+		int writable, SEXP owner)
+{
+	SEXP ans_start, ans_width, ans;
+
+	PROTECT(ans_start = new_extbuf_integer(start, length, writable,
+					       owner));
+	PROTECT(ans_width = new_extbuf_integer(width, length, writable,
+					       owner));
+	PROTECT(ans = _new_IRanges(classname, ans_start, ans_width,
+				   R_NilValue));
+	UNPROTECT(3);
+	return ans;
+}
+
+
 /****************************************************************************
  * Validity functions.
  */
 
+/* Fast path for the common case where the holder points directly to the
+   "start" and "width" slots of an IRanges object. */
+static int is_normal_start_width(const int *start, const int *width, int n)
+{
+	int i;
+
+	if (width[0] <= 0)
+		return 0;
+	for (i = 1; i < n; i++) {
+		if (width[i] <= 0)
+			return 0;
+		/* Same as 'start[i] <= end[i - 1] + 1' but cannot overflow. */
+		if (start[i] - 1 <= start[i - 1] + width[i - 1] - 1)
+			return 0;
+	}
+	return 1;
+}
+
 int _is_normal_IRanges_holder(const IRanges_holder *x_holder)
 {
 	int x_len, i;
@@ -264,6 +456,9 @@ int _is_normal_IRanges_holder(const IRanges_holder *x_holder)
 	x_len = _get_length_from_IRanges_holder(x_holder);
 	if (x_len == 0)
 		return 1;
+	if (x_holder->start != NULL && !x_holder->is_constant_width)
+		return is_normal_start_width(x_holder->start, x_holder->width,
+					     x_len);
 	if (_get_width_elt_from_IRanges_holder(x_holder, 0) <= 0)
 		return 0;
 	for (i = 1; i < x_len; i++) {
@@ -295,41 +490,36 @@ SEXP C_from_integer_to_IRanges(SEXP x)
 {
 	SEXP ans, ans_start, ans_width;
 	int i, x_length, ans_length;
-	int *start_buf, *width_buf;
-	int *x_elt, *start_elt, *width_elt, prev_elt_plus1;
+	const int *x_p;
+	int *start_elt, *width_elt;
 
+	/* 1st pass: check for NAs and count the runs of consecutive
+	   integers. This avoids the need for 2 buffers of the length of 'x'
+	   (which can be huge e.g. when 'x' contains all the positions of
+	   a genome). Note that 'x_p[i] - 1' cannot overflow. */
 	x_length = LENGTH(x);
-	if (x_length == 0) {
-		PROTECT(ans_start = NEW_INTEGER(0));
-		PROTECT(ans_width = NEW_INTEGER(0));
-	} else {
-		ans_length = 1;
-		start_buf = (int *) R_alloc((long) x_length, sizeof(int));
-		width_buf = (int *) R_alloc((long) x_length, sizeof(int));
-		start_buf[0] = INTEGER(x)[0];
-		width_buf[0] = 1;
-		prev_elt_plus1 = start_buf[0] + 1;
-		start_elt = start_buf;
-		width_elt = width_buf;
-		for (i = 1, x_elt = (INTEGER(x)+1); i < x_length; i++, x_elt++) {
-			if (*x_elt == NA_INTEGER)
-				error("cannot create an IRanges object from an integer vector with missing values");
-			if (*x_elt == prev_elt_plus1) {
-				*width_elt += 1;
-			} else {
-				ans_length++;
-				start_elt++;
-				width_elt++;
-				*start_elt = *x_elt;
-				*width_elt = 1;
-				prev_elt_plus1 = *x_elt;
-			}
-			prev_elt_plus1++;
+	x_p = INTEGER(x);
+	ans_length = 0;
+	for (i = 0; i < x_length; i++) {
+		if (x_p[i] == NA_INTEGER)
+			error("cannot create an IRanges object from an "
+			      "integer vector with missing values");
+		if (i == 0 || x_p[i] - 1 != x_p[i - 1])
+			ans_length++;
+	}
+
+	/* 2nd pass: fill the result. */
+	PROTECT(ans_start = NEW_INTEGER(ans_length));
+	PROTECT(ans_width = NEW_INTEGER(ans_length));
+	start_elt = INTEGER(ans_start) - 1;
+	width_elt = INTEGER(ans_width) - 1;
+	for (i = 0; i < x_length; i++) {
+		if (i != 0 && x_p[i] - 1 == x_p[i - 1]) {
+			*width_elt += 1;
+		} else {
+			*(++start_elt) = x_p[i];
+			*(++width_elt) = 1;
 		}
-		PROTECT(ans_start = NEW_INTEGER(ans_length));
-		PROTECT(ans_width = NEW_INTEGER(ans_length));
-		memcpy(INTEGER(ans_start), start_buf, sizeof(int) * ans_length);
-		memcpy(INTEGER(ans_width), width_buf, sizeof(int) * ans_length);
 	}
 
 	PROTECT(ans = _new_IRanges("IRanges", ans_start, ans_width, R_NilValue));
@@ -103,6 +103,117 @@ static int solve_range(int start, int end, int width,
 	return 0;
 }
 
+/*
+ * Fast path for the common cases where, in all the ranges, one of 'start',
+ * 'end', or 'width' is NA and the other two are not. Which one is NA is
+ * determined by looking at the 1st range. A single loop then validates all
+ * the ranges and computes the missing 'start' or 'width' (if any). The loop
+ * doesn't exit early: it only accumulates the validation status so is free
+ * of unpredictable branches. If some ranges turn out to be invalid (or to
+ * follow another NA pattern), R_NilValue is returned and the caller falls
+ * back to solving the ranges one at a time with solve_range(), which will
+ * report the 1st invalid range.
+ */
+
+#define	SEW_START_WIDTH	1  /* 'end' is NA */
+#define	SEW_START_END	2  /* 'width' is NA */
+#define	SEW_END_WIDTH	3  /* 'start' is NA */
+
+static int get_SEW_pattern(int start, int end, int width)
+{
+	if (start != NA_INTEGER && width != NA_INTEGER && end == NA_INTEGER)
+		return SEW_START_WIDTH;
+	if (start != NA_INTEGER && end != NA_INTEGER && width == NA_INTEGER)
+		return SEW_START_END;
+	if (end != NA_INTEGER && width != NA_INTEGER && start == NA_INTEGER)
+		return SEW_END_WIDTH;
+	return 0;
+}
+
+/* Returns a copy of 'x' with no attributes. */
+static SEXP drop_attribs(SEXP x)
+{
+	SEXP ans;
+
+	ans = NEW_INTEGER(LENGTH(x));
+	memcpy(INTEGER(ans), INTEGER(x), sizeof(int) * LENGTH(x));
+	return ans;
+}
+
+static SEXP solve_user_SEW0_fast(SEXP start, SEXP end, SEXP width,
+		int use_start_as_is, int use_width_as_is)
+{
+	int ans_len, pattern, i, s, e, w, ok;
+	const int *start_p, *end_p, *width_p;
+	int *solved_p;
+	long long int tmp;
+	SEXP ans, ans_start, ans_width;
+
+	ans_len = LENGTH(start);
+	start_p = INTEGER(start);
+	end_p = INTEGER(end);
+	width_p = INTEGER(width);
+	pattern = get_SEW_pattern(start_p[0], end_p[0], width_p[0]);
+	if (pattern == 0)
+		return R_NilValue;
+	ok = 1;
+	/* Note that NA_INTEGER is INT_MIN so 'w >= 0' implies 'w' is not NA. */
+	switch (pattern) {
+	    case SEW_START_WIDTH:
+		PROTECT(ans_start = use_start_as_is ? start
+						    : drop_attribs(start));
+		PROTECT(ans_width = use_width_as_is ? width
+						    : drop_attribs(width));
+		for (i = 0; i < ans_len; i++) {
+			s = start_p[i];
+			e = end_p[i];
+			w = width_p[i];
+			tmp = (long long int) s + w - 1;
+			ok &= (s != NA_INTEGER) & (e == NA_INTEGER) & (w >= 0) &
+			      (tmp >= R_INT_MIN) & (tmp <= R_INT_MAX);
+		}
+		break;
+	    case SEW_START_END:
+		PROTECT(ans_start = use_start_as_is ? start
+						    : drop_attribs(start));
+		PROTECT(ans_width = NEW_INTEGER(ans_len));
+		solved_p = INTEGER(ans_width);
+		for (i = 0; i < ans_len; i++) {
+			s = start_p[i];
+			e = end_p[i];
+			w = width_p[i];
+			tmp = (long long int) e - s + 1;
+			ok &= (s != NA_INTEGER) & (e != NA_INTEGER) &
+			      (w == NA_INTEGER) &
+			      (tmp >= 0) & (tmp <= R_INT_MAX);
+			solved_p[i] = (int) tmp;
+		}
+		break;
+	    default:  /* SEW_END_WIDTH */
+		PROTECT(ans_start = NEW_INTEGER(ans_len));
+		PROTECT(ans_width = use_width_as_is ? width
+						    : drop_attribs(width));
+		solved_p = INTEGER(ans_start);
+		for (i = 0; i < ans_len; i++) {
+			s = start_p[i];
+			e = end_p[i];
+			w = width_p[i];
+			tmp = (long long int) e - w + 1;
+			ok &= (s == NA_INTEGER) & (e != NA_INTEGER) & (w >= 0) &
+			      (tmp >= R_INT_MIN) & (tmp <= R_INT_MAX);
+			solved_p[i] = (int) tmp;
+		}
+	}
+	if (!ok) {
+		UNPROTECT(2);
+		return R_NilValue;
+	}
+	PROTECT(ans = _new_IRanges("IRanges", ans_start, ans_width,
+					      R_NilValue));
+	UNPROTECT(3);
+	return ans;
+}
+
 /* --- .Call ENTRY POINT ---
   'start' and 'width' can be used **as-is** to construct the IRanges object
   to return if they satisfy at least both criteria:
@@ -138,6 +249,13 @@ SEXP C_solve_user_SEW0(SEXP start, SEXP end, SEXP width)
 	use_width_as_is = GET_DIM(width) == R_NilValue &&
 			  GET_NAMES(width) == R_NilValue;
 
+	if (ans_len != 0) {
+		ans = solve_user_SEW0_fast(start, end, width,
+					   use_start_as_is, use_width_as_is);
+		if (ans != R_NilValue)
+			return ans;
+	}
+
 	/* 1st pass: Solve and check the supplied ranges and determine
            whether 'start' and/or 'width' can be used as-is or not. */
 	start_p = INTEGER(start);
@@ -307,24 +425,35 @@ SEXP C_solve_user_SEW(SEXP refwidths, SEXP start, SEXP end, SEXP width,
 		SEXP translate_negative_coord, SEXP allow_nonnarrowing)
 {
 	SEXP ans, ans_start, ans_width;
-	int ans_len, i0, i1, i2, i3;
+	int ans_len, start_len, end_len, width_len, i0, i1, i2, i3;
+	const int *refwidths_p, *start_p, *end_p, *width_p;
+	int *ans_start_p, *ans_width_p;
 
 	translate_negative_coord0 = LOGICAL(translate_negative_coord)[0];
 	nonnarrowing_is_OK = LOGICAL(allow_nonnarrowing)[0];
 	ans_len = LENGTH(refwidths);
+	start_len = LENGTH(start);
+	end_len = LENGTH(end);
+	width_len = LENGTH(width);
+	refwidths_p = INTEGER(refwidths);
+	start_p = INTEGER(start);
+	end_p = INTEGER(end);
+	width_p = INTEGER(width);
 	PROTECT(ans_start = NEW_INTEGER(ans_len));
 	PROTECT(ans_width = NEW_INTEGER(ans_len));
+	ans_start_p = INTEGER(ans_start);
+	ans_width_p = INTEGER(ans_width);
 	for (i0 = i1 = i2 = i3 = 0; i0 < ans_len; i0++, i1++, i2++, i3++) {
 		/* recycling */
-		if (i1 >= LENGTH(start)) i1 = 0;
-		if (i2 >= LENGTH(end)) i2 = 0;
-		if (i3 >= LENGTH(width)) i3 = 0;
-		if (solve_user_SEW_row(INTEGER(refwidths)[i0],
-				       INTEGER(start)[i1],
-				       INTEGER(end)[i2],
-				       INTEGER(width)[i3],
-				       INTEGER(ans_start) + i0,
-				       INTEGER(ans_width) + i0) != 0)
+		if (i1 >= start_len) i1 = 0;
+		if (i2 >= end_len) i2 = 0;
+		if (i3 >= width_len) i3 = 0;
+		if (solve_user_SEW_row(refwidths_p[i0],
+				       start_p[i1],
+				       end_p[i2],
+				       width_p[i3],
+				       ans_start_p + i0,
+				       ans_width_p + i0) != 0)
 		{
 			UNPROTECT(2);
 			error("solving row %d: %s", i0 + 1, errmsg_buf);
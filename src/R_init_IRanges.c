@@ -12,12 +12,21 @@ static const R_CallMethodDef callMethods[] = {
 
 /* IPosRanges_comparison.c */
 	CALLMETHOD_DEF(C_pcompare_IPosRanges, 4),
+	CALLMETHOD_DEF(C_match_IPosRanges_in_sorted_table, 5),
+	CALLMETHOD_DEF(C_selfmatch_sorted_IPosRanges, 2),
+	CALLMETHOD_DEF(C_radix_order_IPosRanges, 3),
 
 /* IRanges_class.c */
 	CALLMETHOD_DEF(C_isNormal_IRanges, 1),
 	CALLMETHOD_DEF(C_from_integer_to_IRanges, 1),
 	CALLMETHOD_DEF(C_from_logical_to_NormalIRanges, 1),
 
+/* IPos_class.c */
+	CALLMETHOD_DEF(C_stitch_IntegerRanges, 3),
+	CALLMETHOD_DEF(C_unstitch_IntegerRanges, 2),
+	CALLMETHOD_DEF(C_get_pos_from_runs, 3),
+	CALLMETHOD_DEF(C_map_run_hits_to_pos, 7),
+
 /* IRanges_constructor.c */
 	CALLMETHOD_DEF(C_solve_user_SEW0, 3),
 	CALLMETHOD_DEF(C_solve_user_SEW, 6),
@@ -33,6 +42,9 @@ static const R_CallMethodDef callMethods[] = {
 	CALLMETHOD_DEF(C_viewMeans_RleViews, 2),
 	CALLMETHOD_DEF(C_viewWhichMins_RleViews, 2),
 	CALLMETHOD_DEF(C_viewWhichMaxs_RleViews, 2),
+	CALLMETHOD_DEF(C_viewSummaries_RleViews, 3),
+	CALLMETHOD_DEF(C_viewSummary_RleViewsList, 3),
+	CALLMETHOD_DEF(C_viewApply_RleViews, 6),
 
 /* SimpleIRangesList_class.c */
 	CALLMETHOD_DEF(C_isNormal_SimpleIRangesList, 2),
@@ -45,14 +57,27 @@ static const R_CallMethodDef callMethods[] = {
 	CALLMETHOD_DEF(C_min_CompressedNormalIRangesList, 2),
 	CALLMETHOD_DEF(C_max_CompressedNormalIRangesList, 2),
 
+/* intra_range_methods.c */
+	CALLMETHOD_DEF(C_restrict_ranges, 6),
+	CALLMETHOD_DEF(C_resize_ranges, 5),
+	CALLMETHOD_DEF(C_flank_ranges, 5),
+	CALLMETHOD_DEF(C_promoters_ranges, 4),
+
 /* inter_range_methods.c */
 	CALLMETHOD_DEF(C_range_IRanges, 1),
 	CALLMETHOD_DEF(C_reduce_IntegerRanges, 6),
 	CALLMETHOD_DEF(C_reduce_CompressedIRangesList, 4),
+	CALLMETHOD_DEF(C_reduce_sorted_chunk, 6),
 	CALLMETHOD_DEF(C_gaps_IntegerRanges, 4),
 	CALLMETHOD_DEF(C_gaps_CompressedIRangesList, 3),
+	CALLMETHOD_DEF(C_setop_IntegerRanges, 5),
+	CALLMETHOD_DEF(C_setop_CompressedIRangesList, 3),
 	CALLMETHOD_DEF(C_disjointBins_IntegerRanges, 2),
 
+/* slice_methods.c */
+	CALLMETHOD_DEF(C_slice_Rle, 6),
+	CALLMETHOD_DEF(C_multislice_Rle, 3),
+
 /* coverage_methods.c */
 	CALLMETHOD_DEF(C_coverage_IRanges, 6),
 	CALLMETHOD_DEF(C_coverage_CompressedIRangesList, 6),
@@ -85,9 +110,51 @@ static const R_CallMethodDef callMethods[] = {
 	CALLMETHOD_DEF(C_which_max_CompressedLogicalList, 1),
 	CALLMETHOD_DEF(C_which_max_CompressedIntegerList, 1),
 	CALLMETHOD_DEF(C_which_max_CompressedNumericList, 1),
+	CALLMETHOD_DEF(C_range_with_which_CompressedLogicalList, 2),
+	CALLMETHOD_DEF(C_range_with_which_CompressedIntegerList, 2),
+	CALLMETHOD_DEF(C_range_with_which_CompressedNumericList, 2),
 	CALLMETHOD_DEF(C_is_unsorted_CompressedLogicalList, 3),
 	CALLMETHOD_DEF(C_is_unsorted_CompressedIntegerList, 3),
 	CALLMETHOD_DEF(C_is_unsorted_CompressedNumericList, 3),
+	CALLMETHOD_DEF(C_mean_CompressedLogicalList, 2),
+	CALLMETHOD_DEF(C_mean_CompressedIntegerList, 2),
+	CALLMETHOD_DEF(C_mean_CompressedNumericList, 2),
+	CALLMETHOD_DEF(C_var_CompressedLogicalList, 2),
+	CALLMETHOD_DEF(C_var_CompressedIntegerList, 2),
+	CALLMETHOD_DEF(C_var_CompressedNumericList, 2),
+	CALLMETHOD_DEF(C_median_CompressedLogicalList, 2),
+	CALLMETHOD_DEF(C_median_CompressedIntegerList, 2),
+	CALLMETHOD_DEF(C_median_CompressedNumericList, 2),
+	CALLMETHOD_DEF(C_mad_CompressedLogicalList, 2),
+	CALLMETHOD_DEF(C_mad_CompressedIntegerList, 2),
+	CALLMETHOD_DEF(C_mad_CompressedNumericList, 2),
+	CALLMETHOD_DEF(C_quantile_CompressedLogicalList, 3),
+	CALLMETHOD_DEF(C_quantile_CompressedIntegerList, 3),
+	CALLMETHOD_DEF(C_quantile_CompressedNumericList, 3),
+	CALLMETHOD_DEF(C_cumsum_CompressedLogicalList, 1),
+	CALLMETHOD_DEF(C_cumsum_CompressedIntegerList, 1),
+	CALLMETHOD_DEF(C_cumsum_CompressedNumericList, 1),
+	CALLMETHOD_DEF(C_cumprod_CompressedLogicalList, 1),
+	CALLMETHOD_DEF(C_cumprod_CompressedIntegerList, 1),
+	CALLMETHOD_DEF(C_cumprod_CompressedNumericList, 1),
+	CALLMETHOD_DEF(C_cummin_CompressedLogicalList, 1),
+	CALLMETHOD_DEF(C_cummin_CompressedIntegerList, 1),
+	CALLMETHOD_DEF(C_cummin_CompressedNumericList, 1),
+	CALLMETHOD_DEF(C_cummax_CompressedLogicalList, 1),
+	CALLMETHOD_DEF(C_cummax_CompressedIntegerList, 1),
+	CALLMETHOD_DEF(C_cummax_CompressedNumericList, 1),
+	CALLMETHOD_DEF(C_diff_CompressedLogicalList, 3),
+	CALLMETHOD_DEF(C_diff_CompressedIntegerList, 3),
+	CALLMETHOD_DEF(C_diff_CompressedNumericList, 3),
+	CALLMETHOD_DEF(C_runsum_CompressedAtomicList, 4),
+	CALLMETHOD_DEF(C_runmean_CompressedAtomicList, 4),
+	CALLMETHOD_DEF(C_runwtsum_CompressedAtomicList, 5),
+	CALLMETHOD_DEF(C_runq_CompressedAtomicList, 5),
+	CALLMETHOD_DEF(C_runmed_CompressedAtomicList, 3),
+	CALLMETHOD_DEF(C_order_CompressedAtomicList, 4),
+	CALLMETHOD_DEF(C_rank_CompressedAtomicList, 2),
+	CALLMETHOD_DEF(C_selfmatch_CompressedAtomicList, 2),
+	CALLMETHOD_DEF(C_duplicated_CompressedAtomicList, 2),
 
 /* extractListFragments.c */
 	CALLMETHOD_DEF(C_find_partition_overlaps, 3),
@@ -100,9 +167,13 @@ void R_init_IRanges(DllInfo *info)
 {
 	R_registerRoutines(info, NULL, callMethods, NULL, NULL);
 
+/* IRanges_class.c */
+	_init_external_buffer_classes(info);
+
 /* IPosRanges_comparison.c */
 	REGISTER_CCALLABLE(_overlap_code);
 	REGISTER_CCALLABLE(_invert_overlap_code);
+	REGISTER_CCALLABLE(_pcompare_ranges);
 
 /* IRanges_class.c */
 	REGISTER_CCALLABLE(_get_IRanges_start);
@@ -122,6 +193,7 @@ void R_init_IRanges(DllInfo *info)
 	REGISTER_CCALLABLE(_new_IRanges_from_IntPairAE);
 	REGISTER_CCALLABLE(_new_list_of_IRanges_from_IntPairAEAE);
 	REGISTER_CCALLABLE(_alloc_IRanges);
+	REGISTER_CCALLABLE(_new_IRanges_from_external_buffers);
 
 /* Grouping_class.c */
 	REGISTER_CCALLABLE(_get_H2LGrouping_high2low);
@@ -5,6 +5,241 @@
 
 #define R_INT_MIN	(1+INT_MIN)
 
+/* Decide whether building an index over the runs is worth it. Walking the
+   runs costs about 'total_width * nrun / subject_length' run visits (the
+   total width of the views times the average run density), while the index
+   costs about 'build_cost * nrun' to build plus 'query_cost * log2(nrun)'
+   steps per view. */
+static int run_index_pays_off(const IRanges_holder *ranges_holder,
+		SEXP lengths, double build_cost, double query_cost)
+{
+	int nview, nrun, i, k;
+	double total_width, subject_len, log2_nrun;
+
+	nview = _get_length_from_IRanges_holder(ranges_holder);
+	nrun = LENGTH(lengths);
+	if (nview == 0 || nrun < 64)
+		return 0;
+	total_width = 0;
+	for (i = 0; i < nview; i++)
+		total_width += _get_width_elt_from_IRanges_holder(
+					ranges_holder, i);
+	subject_len = 0;
+	for (k = 0; k < nrun; k++)
+		subject_len += INTEGER(lengths)[k];
+	for (log2_nrun = 0, k = nrun; k > 1; k >>= 1)
+		log2_nrun++;
+	return total_width * nrun / subject_len >
+	       build_cost * nrun + query_cost * log2_nrun * nview;
+}
+
+/****************************************************************************
+ * Range min/max index over the runs of an Rle
+ *
+ * A segment tree over the run values (one leaf per run) that returns the
+ * index of the leftmost run with the min (or max) value in any range of
+ * runs in O(log(nrun)). Used by viewMins(), viewMaxs(), viewWhichMins(), and
+ * viewWhichMaxs() when the views span a lot of runs (e.g. max coverage over
+ * millions of windows of a chromosome-length Rle). Views that span only a
+ * few runs are still handled with a linear scan of their runs.
+ * NAs are given the value that the C_view*_RleViews() functions use to
+ * initialize their result (INT_MAX/R_INT_MIN or +Inf/-Inf) and never win
+ * against a non-NA run, so the results are identical to those obtained by
+ * walking the runs.
+ */
+
+#define	SHORT_VIEW_MAX_NRUN	16
+
+typedef struct rle_minmax_index {
+	int nrun;
+	int is_max;
+	const int *lengths;
+	long long int *run_ends;  /* 1-based end of each run */
+	double *keys;		  /* run values, NAs replaced with 'init' */
+	int *is_na;		  /* 1 if the run value is NA */
+	int *cumna;		  /* nb of NA runs before each run */
+	int *tree;		  /* 2 * nrun run indices, leaves at nrun */
+	double init;
+} RleMinMaxIndex;
+
+static int better_run(const RleMinMaxIndex *index, int k1, int k2)
+{
+	double key1 = index->keys[k1], key2 = index->keys[k2];
+
+	if (index->is_na[k1] != index->is_na[k2])
+		return index->is_na[k1] ? k2 : k1;
+	if (key1 == key2)
+		return k1 < k2 ? k1 : k2;
+	if (index->is_max)
+		return key1 > key2 ? k1 : k2;
+	return key1 < key2 ? k1 : k2;
+}
+
+static RleMinMaxIndex build_RleMinMaxIndex(SEXP values, SEXP lengths,
+		int is_max)
+{
+	RleMinMaxIndex index;
+	int n, k, is_int;
+	long long int end;
+	double v;
+
+	is_int = TYPEOF(values) != REALSXP;
+	n = index.nrun = LENGTH(lengths);
+	index.is_max = is_max;
+	index.lengths = INTEGER(lengths);
+	if (is_int)
+		index.init = is_max ? R_INT_MIN : INT_MAX;
+	else
+		index.init = is_max ? R_NegInf : R_PosInf;
+	index.run_ends = (long long int *) R_alloc((long) n,
+						   sizeof(long long int));
+	index.keys = (double *) R_alloc((long) n, sizeof(double));
+	index.is_na = (int *) R_alloc((long) n, sizeof(int));
+	index.cumna = (int *) R_alloc((long) n + 1, sizeof(int));
+	index.tree = (int *) R_alloc(2 * (long) n, sizeof(int));
+	end = 0;
+	index.cumna[0] = 0;
+	for (k = 0; k < n; k++) {
+		end += index.lengths[k];
+		index.run_ends[k] = end;
+		if (is_int) {
+			index.is_na[k] = INTEGER(values)[k] == NA_INTEGER;
+			v = (double) INTEGER(values)[k];
+		} else {
+			v = REAL(values)[k];
+			index.is_na[k] = ISNAN(v);
+		}
+		index.keys[k] = index.is_na[k] ? index.init : v;
+		index.cumna[k + 1] = index.cumna[k] + index.is_na[k];
+		index.tree[n + k] = k;
+	}
+	for (k = n - 1; k >= 1; k--)
+		index.tree[k] = better_run(&index, index.tree[2 * k],
+					   index.tree[2 * k + 1]);
+	return index;
+}
+
+/* Index of the run that contains position 'pos'. */
+static int find_run(const RleMinMaxIndex *index, long long int pos)
+{
+	int lo, hi, mid;
+
+	lo = 0;
+	hi = index->nrun - 1;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (index->run_ends[mid] < pos)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/* Leftmost best run in runs 'k1' to 'k2' (inclusive). */
+static int query_RleMinMaxIndex(const RleMinMaxIndex *index, int k1, int k2)
+{
+	int best, l, r;
+
+	if (k2 - k1 < SHORT_VIEW_MAX_NRUN) {
+		for (best = k1, l = k1 + 1; l <= k2; l++)
+			best = better_run(index, best, l);
+		return best;
+	}
+	best = k1;
+	for (l = k1 + index->nrun, r = k2 + 1 + index->nrun; l < r;
+	     l >>= 1, r >>= 1)
+	{
+		if (l & 1)
+			best = better_run(index, best, index->tree[l++]);
+		if (r & 1)
+			best = better_run(index, best, index->tree[--r]);
+	}
+	return best;
+}
+
+/* Same as the loops in the C_viewWhich*_RleViews() functions when 'na_rm' is
+   FALSE and the view contains NAs: stop at the 1st NA. */
+static int which_before_first_NA(const RleMinMaxIndex *index, int k1, int k2)
+{
+	int best, k;
+	double best_key;
+
+	best = -1;
+	best_key = index->init;
+	for (k = k1; k <= k2 && !index->is_na[k]; k++) {
+		if (best == -1 || (index->is_max ? index->keys[k] > best_key
+						 : index->keys[k] < best_key))
+		{
+			best = k;
+			best_key = index->keys[k];
+		}
+	}
+	return best;
+}
+
+/* If 'which' is 0, store the min (or max) of each view in 'ans'. Otherwise
+   store the position of the 1st min (or max) of each view. */
+static void viewExtrema_from_RleMinMaxIndex(const RleMinMaxIndex *index,
+		const IRanges_holder *ranges_holder, int na_rm, int which,
+		SEXP ans)
+{
+	int nview, i, start, width, k1, k2, best, has_na, ans_is_int;
+	double v;
+
+	nview = _get_length_from_IRanges_holder(ranges_holder);
+	ans_is_int = TYPEOF(ans) == INTSXP;
+	for (i = 0; i < nview; i++) {
+		if (i % 100000 == 99999)
+			R_CheckUserInterrupt();
+		start = _get_start_elt_from_IRanges_holder(ranges_holder, i);
+		width = _get_width_elt_from_IRanges_holder(ranges_holder, i);
+		if (width <= 0) {
+			if (which)
+				INTEGER(ans)[i] = NA_INTEGER;
+			else if (ans_is_int)
+				INTEGER(ans)[i] = (int) index->init;
+			else
+				REAL(ans)[i] = index->init;
+			continue;
+		}
+		k1 = find_run(index, start);
+		k2 = find_run(index, (long long int) start + width - 1);
+		has_na = index->cumna[k2 + 1] != index->cumna[k1];
+		if (has_na && !na_rm) {
+			if (which) {
+				best = which_before_first_NA(index, k1, k2);
+			} else {
+				if (ans_is_int)
+					INTEGER(ans)[i] = NA_INTEGER;
+				else
+					REAL(ans)[i] = NA_REAL;
+				continue;
+			}
+		} else {
+			best = query_RleMinMaxIndex(index, k1, k2);
+			if (index->is_na[best])
+				best = -1;
+		}
+		if (which) {
+			if (best == -1) {
+				INTEGER(ans)[i] = NA_INTEGER;
+			} else {
+				v = (double) (index->run_ends[best] -
+					      index->lengths[best] + 1);
+				INTEGER(ans)[i] = v > start ? (int) v : start;
+			}
+			continue;
+		}
+		v = best == -1 ? index->init : index->keys[best];
+		if (ans_is_int)
+			INTEGER(ans)[i] = (int) v;
+		else
+			REAL(ans)[i] = v;
+	}
+	return;
+}
+
 /* --- .Call ENTRY POINT --- */
 SEXP C_viewMins_RleViews(SEXP x, SEXP na_rm)
 {
@@ -13,6 +248,7 @@ SEXP C_viewMins_RleViews(SEXP x, SEXP na_rm)
 	int max_index, *lengths_elt;
 	SEXP ans, subject, values, lengths, ranges, names;
 	IRanges_holder ranges_holder;
+	RleMinMaxIndex minmax_index;
 
 	subject = GET_SLOT(x, install("subject"));
 	values = GET_SLOT(subject, install("values"));
@@ -39,6 +275,16 @@ SEXP C_viewMins_RleViews(SEXP x, SEXP na_rm)
 	if (!IS_LOGICAL(na_rm) || LENGTH(na_rm) != 1 || LOGICAL(na_rm)[0] == NA_LOGICAL)
 		error("'na.rm' must be TRUE or FALSE");
 
+	if (run_index_pays_off(&ranges_holder, lengths, 3.0, 4.0)) {
+		minmax_index = build_RleMinMaxIndex(values, lengths, 0);
+		viewExtrema_from_RleMinMaxIndex(&minmax_index, &ranges_holder,
+						LOGICAL(na_rm)[0], 0, ans);
+		PROTECT(names = duplicate(_get_IRanges_names(ranges)));
+		SET_NAMES(ans, names);
+		UNPROTECT(2);
+		return ans;
+	}
+
 	lengths_elt = INTEGER(lengths);
 	max_index = LENGTH(lengths) - 1;
 	index = 0;
@@ -121,6 +367,7 @@ SEXP C_viewMaxs_RleViews(SEXP x, SEXP na_rm)
 	int max_index, *lengths_elt;
 	SEXP ans, subject, values, lengths, ranges, names;
 	IRanges_holder ranges_holder;
+	RleMinMaxIndex minmax_index;
 
 	subject = GET_SLOT(x, install("subject"));
 	values = GET_SLOT(subject, install("values"));
@@ -147,6 +394,16 @@ SEXP C_viewMaxs_RleViews(SEXP x, SEXP na_rm)
 	if (!IS_LOGICAL(na_rm) || LENGTH(na_rm) != 1 || LOGICAL(na_rm)[0] == NA_LOGICAL)
 		error("'na.rm' must be TRUE or FALSE");
 
+	if (run_index_pays_off(&ranges_holder, lengths, 3.0, 4.0)) {
+		minmax_index = build_RleMinMaxIndex(values, lengths, 1);
+		viewExtrema_from_RleMinMaxIndex(&minmax_index, &ranges_holder,
+						LOGICAL(na_rm)[0], 0, ans);
+		PROTECT(names = duplicate(_get_IRanges_names(ranges)));
+		SET_NAMES(ans, names);
+		UNPROTECT(2);
+		return ans;
+	}
+
 	lengths_elt = INTEGER(lengths);
 	max_index = LENGTH(lengths) - 1;
 	index = 0;
@@ -221,6 +478,165 @@ SEXP C_viewMaxs_RleViews(SEXP x, SEXP na_rm)
 	return ans;
 }
 
+/****************************************************************************
+ * Cumulative-sum index over the runs of an integer Rle
+ *
+ * With this index, the sum (and number of NAs) of any view is obtained with
+ * 2 binary searches and a subtraction, instead of walking all the runs
+ * overlapping with the view. The index is built in O(nrun) so it only pays
+ * off when the views span a lot of runs (e.g. large or overlapping views on
+ * a genome-wide coverage). It's only used for integer (and logical) Rles,
+ * for which the prefix sums are computed exactly in double precision (as
+ * long as they don't exceed 2^53) so the results are identical to those
+ * obtained by walking the runs.
+ */
+
+typedef struct rle_cumsum_index {
+	int nrun;
+	const int *values;
+	const int *lengths;
+	long long int *run_ends;  /* 1-based end of each run */
+	double *cumsum;		  /* sum of the non-NA values before each run */
+	long long int *cumna;	  /* nb of NA positions before each run */
+} RleCumsumIndex;
+
+static RleCumsumIndex build_RleCumsumIndex(SEXP values, SEXP lengths)
+{
+	RleCumsumIndex index;
+	int k, v, len;
+	long long int end;
+
+	index.nrun = LENGTH(lengths);
+	index.values = INTEGER(values);
+	index.lengths = INTEGER(lengths);
+	index.run_ends = (long long int *)
+		R_alloc((long) index.nrun, sizeof(long long int));
+	index.cumsum = (double *)
+		R_alloc((long) index.nrun + 1, sizeof(double));
+	index.cumna = (long long int *)
+		R_alloc((long) index.nrun + 1, sizeof(long long int));
+	end = 0;
+	index.cumsum[0] = 0;
+	index.cumna[0] = 0;
+	for (k = 0; k < index.nrun; k++) {
+		v = index.values[k];
+		len = index.lengths[k];
+		end += len;
+		index.run_ends[k] = end;
+		if (v == NA_INTEGER) {
+			index.cumsum[k + 1] = index.cumsum[k];
+			index.cumna[k + 1] = index.cumna[k] + len;
+		} else {
+			index.cumsum[k + 1] = index.cumsum[k] +
+					      (double) v * len;
+			index.cumna[k + 1] = index.cumna[k];
+		}
+	}
+	return index;
+}
+
+/* Sum of the non-NA values and nb of NAs in positions 1 to 'pos'. */
+static void prefix_from_RleCumsumIndex(const RleCumsumIndex *index,
+		long long int pos, double *sum, long long int *nna)
+{
+	int lo, hi, mid, v;
+	long long int offset;
+
+	*sum = 0;
+	*nna = 0;
+	if (pos <= 0 || index->nrun == 0)
+		return;
+	/* Find the 1st run whose end is >= 'pos'. */
+	lo = 0;
+	hi = index->nrun - 1;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (index->run_ends[mid] < pos)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	offset = pos - (index->run_ends[lo] - index->lengths[lo]);
+	v = index->values[lo];
+	*sum = index->cumsum[lo];
+	*nna = index->cumna[lo];
+	if (v == NA_INTEGER)
+		*nna += offset;
+	else
+		*sum += (double) v * offset;
+	return;
+}
+
+static void view_from_RleCumsumIndex(const RleCumsumIndex *index,
+		int start, int width, double *sum, long long int *nna)
+{
+	double sum1, sum2;
+	long long int nna1, nna2;
+
+	prefix_from_RleCumsumIndex(index, (long long int) start - 1,
+				   &sum1, &nna1);
+	prefix_from_RleCumsumIndex(index, (long long int) start + width - 1,
+				   &sum2, &nna2);
+	*sum = sum2 - sum1;
+	*nna = nna2 - nna1;
+	return;
+}
+
+static void viewSums_from_RleCumsumIndex(const RleCumsumIndex *index,
+		const IRanges_holder *ranges_holder, int na_rm, int *out)
+{
+	int nview, i, width;
+	double sum;
+	long long int nna;
+
+	nview = _get_length_from_IRanges_holder(ranges_holder);
+	for (i = 0; i < nview; i++) {
+		width = _get_width_elt_from_IRanges_holder(ranges_holder, i);
+		if (width <= 0) {
+			out[i] = 0;
+			continue;
+		}
+		view_from_RleCumsumIndex(index,
+			_get_start_elt_from_IRanges_holder(ranges_holder, i),
+			width, &sum, &nna);
+		if (nna != 0 && !na_rm) {
+			out[i] = NA_INTEGER;
+			continue;
+		}
+		if (sum > INT_MAX || sum < R_INT_MIN)
+			error("Integer overflow");
+		out[i] = (int) sum;
+	}
+	return;
+}
+
+static void viewMeans_from_RleCumsumIndex(const RleCumsumIndex *index,
+		const IRanges_holder *ranges_holder, int na_rm, double *out)
+{
+	int nview, i, width;
+	double sum;
+	long long int nna;
+
+	nview = _get_length_from_IRanges_holder(ranges_holder);
+	for (i = 0; i < nview; i++) {
+		width = _get_width_elt_from_IRanges_holder(ranges_holder, i);
+		if (width <= 0) {
+			out[i] = R_NaN;
+			continue;
+		}
+		view_from_RleCumsumIndex(index,
+			_get_start_elt_from_IRanges_holder(ranges_holder, i),
+			width, &sum, &nna);
+		if (nna != 0 && !na_rm)
+			out[i] = NA_REAL;
+		else if (nna == width)
+			out[i] = R_NaN;
+		else
+			out[i] = sum / (width - nna);
+	}
+	return;
+}
+
 /* --- .Call ENTRY POINT --- */
 SEXP C_viewSums_RleViews(SEXP x, SEXP na_rm)
 {
@@ -230,6 +646,7 @@ SEXP C_viewSums_RleViews(SEXP x, SEXP na_rm)
 	int max_index, *lengths_elt;
 	SEXP ans, subject, values, lengths, ranges, names;
 	IRanges_holder ranges_holder;
+	RleCumsumIndex cumsum_index;
 
 	subject = GET_SLOT(x, install("subject"));
 	values = GET_SLOT(subject, install("values"));
@@ -260,6 +677,16 @@ SEXP C_viewSums_RleViews(SEXP x, SEXP na_rm)
 	if (!IS_LOGICAL(na_rm) || LENGTH(na_rm) != 1 || LOGICAL(na_rm)[0] == NA_LOGICAL)
 		error("'na.rm' must be TRUE or FALSE");
 
+	if (type == 'i' && run_index_pays_off(&ranges_holder, lengths, 1.0, 2.0)) {
+		cumsum_index = build_RleCumsumIndex(values, lengths);
+		viewSums_from_RleCumsumIndex(&cumsum_index, &ranges_holder,
+					     LOGICAL(na_rm)[0], INTEGER(ans));
+		PROTECT(names = duplicate(_get_IRanges_names(ranges)));
+		SET_NAMES(ans, names);
+		UNPROTECT(2);
+		return ans;
+	}
+
 	lengths_elt = INTEGER(lengths);
 	max_index = LENGTH(lengths) - 1;
 	index = 0;
@@ -382,6 +809,7 @@ SEXP C_viewMeans_RleViews(SEXP x, SEXP na_rm)
 	int max_index, *lengths_elt;
 	SEXP ans, subject, values, lengths, ranges, names;
 	IRanges_holder ranges_holder;
+	RleCumsumIndex cumsum_index;
 
 	subject = GET_SLOT(x, install("subject"));
 	values = GET_SLOT(subject, install("values"));
@@ -412,6 +840,16 @@ SEXP C_viewMeans_RleViews(SEXP x, SEXP na_rm)
 	if (!IS_LOGICAL(na_rm) || LENGTH(na_rm) != 1 || LOGICAL(na_rm)[0] == NA_LOGICAL)
 		error("'na.rm' must be TRUE or FALSE");
 
+	if (type == 'i' && run_index_pays_off(&ranges_holder, lengths, 1.0, 2.0)) {
+		cumsum_index = build_RleCumsumIndex(values, lengths);
+		viewMeans_from_RleCumsumIndex(&cumsum_index, &ranges_holder,
+					      LOGICAL(na_rm)[0], REAL(ans));
+		PROTECT(names = duplicate(_get_IRanges_names(ranges)));
+		SET_NAMES(ans, names);
+		UNPROTECT(2);
+		return ans;
+	}
+
 	lengths_elt = INTEGER(lengths);
 	max_index = LENGTH(lengths) - 1;
 	index = 0;
@@ -568,6 +1006,7 @@ SEXP C_viewWhichMins_RleViews(SEXP x, SEXP na_rm)
 	int max_index, *ans_elt, *lengths_elt;
 	SEXP curr, ans, subject, values, lengths, ranges, names;
 	IRanges_holder ranges_holder;
+	RleMinMaxIndex minmax_index;
 
 	subject = GET_SLOT(x, install("subject"));
 	values = GET_SLOT(subject, install("values"));
@@ -595,6 +1034,17 @@ SEXP C_viewWhichMins_RleViews(SEXP x, SEXP na_rm)
 		error("'na.rm' must be TRUE or FALSE");
 
 	PROTECT(ans = NEW_INTEGER(ans_len));
+
+	if (run_index_pays_off(&ranges_holder, lengths, 3.0, 4.0)) {
+		minmax_index = build_RleMinMaxIndex(values, lengths, 0);
+		viewExtrema_from_RleMinMaxIndex(&minmax_index, &ranges_holder,
+						LOGICAL(na_rm)[0], 1, ans);
+		PROTECT(names = duplicate(_get_IRanges_names(ranges)));
+		SET_NAMES(ans, names);
+		UNPROTECT(3);
+		return ans;
+	}
+
 	lengths_elt = INTEGER(lengths);
 	max_index = LENGTH(lengths) - 1;
 	index = 0;
@@ -630,7 +1080,9 @@ SEXP C_viewWhichMins_RleViews(SEXP x, SEXP na_rm)
 						if (!LOGICAL(na_rm)[0]) {
 							break;
 						}
-					} else if (INTEGER(values)[index] < INTEGER(curr)[0]) {
+					} else if (*ans_elt == NA_INTEGER ||
+						   INTEGER(values)[index] < INTEGER(curr)[0])
+					{
 						*ans_elt = lower_bound;
 						INTEGER(curr)[0] = INTEGER(values)[index];
 					}
@@ -650,7 +1102,9 @@ SEXP C_viewWhichMins_RleViews(SEXP x, SEXP na_rm)
 						if (!LOGICAL(na_rm)[0]) {
 							break;
 						}
-					} else if (REAL(values)[index] < REAL(curr)[0]) {
+					} else if (*ans_elt == NA_INTEGER ||
+						   REAL(values)[index] < REAL(curr)[0])
+					{
 						*ans_elt = lower_bound;
 						REAL(curr)[0] = REAL(values)[index];
 					}
@@ -682,6 +1136,7 @@ SEXP C_viewWhichMaxs_RleViews(SEXP x, SEXP na_rm)
 	int max_index, *ans_elt, *lengths_elt;
 	SEXP curr, ans, subject, values, lengths, ranges, names;
 	IRanges_holder ranges_holder;
+	RleMinMaxIndex minmax_index;
 
 	subject = GET_SLOT(x, install("subject"));
 	values = GET_SLOT(subject, install("values"));
@@ -709,6 +1164,17 @@ SEXP C_viewWhichMaxs_RleViews(SEXP x, SEXP na_rm)
 		error("'na.rm' must be TRUE or FALSE");
 
 	PROTECT(ans = NEW_INTEGER(ans_len));
+
+	if (run_index_pays_off(&ranges_holder, lengths, 3.0, 4.0)) {
+		minmax_index = build_RleMinMaxIndex(values, lengths, 1);
+		viewExtrema_from_RleMinMaxIndex(&minmax_index, &ranges_holder,
+						LOGICAL(na_rm)[0], 1, ans);
+		PROTECT(names = duplicate(_get_IRanges_names(ranges)));
+		SET_NAMES(ans, names);
+		UNPROTECT(3);
+		return ans;
+	}
+
 	lengths_elt = INTEGER(lengths);
 	max_index = LENGTH(lengths) - 1;
 	index = 0;
@@ -744,7 +1210,9 @@ SEXP C_viewWhichMaxs_RleViews(SEXP x, SEXP na_rm)
 						if (!LOGICAL(na_rm)[0]) {
 							break;
 						}
-					} else if (INTEGER(values)[index] > INTEGER(curr)[0]) {
+					} else if (*ans_elt == NA_INTEGER ||
+						   INTEGER(values)[index] > INTEGER(curr)[0])
+					{
 						*ans_elt = lower_bound;
 						INTEGER(curr)[0] = INTEGER(values)[index];
 					}
@@ -764,7 +1232,9 @@ SEXP C_viewWhichMaxs_RleViews(SEXP x, SEXP na_rm)
 						if (!LOGICAL(na_rm)[0]) {
 							break;
 						}
-					} else if (REAL(values)[index] > REAL(curr)[0]) {
+					} else if (*ans_elt == NA_INTEGER ||
+						   REAL(values)[index] > REAL(curr)[0])
+					{
 						*ans_elt = lower_bound;
 						REAL(curr)[0] = REAL(values)[index];
 					}
@@ -786,3 +1256,701 @@ SEXP C_viewWhichMaxs_RleViews(SEXP x, SEXP na_rm)
 	UNPROTECT(3);
 	return ans;
 }
+
+/****************************************************************************
+ * Single-pass computation of several view summaries
+ *
+ * C_viewSummaries_RleViews() walks the runs of each view only once and
+ * computes any subset of the min, max, sum, mean, which.min, and which.max
+ * summaries. The results are identical to those returned by the individual
+ * C_view*_RleViews() functions above. Accumulation is done in double
+ * precision (which is exact for the values of an integer Rle) and the
+ * results are coerced back to integer where appropriate.
+ */
+
+#define	VIEWSUMMARY_MIN		0
+#define	VIEWSUMMARY_MAX		1
+#define	VIEWSUMMARY_SUM		2
+#define	VIEWSUMMARY_MEAN	3
+#define	VIEWSUMMARY_WHICH_MIN	4
+#define	VIEWSUMMARY_WHICH_MAX	5
+#define	VIEWSUMMARY_NSTATS	6
+
+static const char *viewsummary_names[] = {
+	"min", "max", "sum", "mean", "which.min", "which.max"
+};
+
+typedef struct view_summary {
+	int is_na;	/* NA found and 'na_rm' is FALSE */
+	double min, max, sum;
+	int n;		/* nb of non-NA positions (used by mean) */
+	int which_min, which_max;
+} ViewSummary;
+
+static int get_viewsummary_code(SEXP stat)
+{
+	int k;
+
+	if (stat != NA_STRING) {
+		for (k = 0; k < VIEWSUMMARY_NSTATS; k++)
+			if (strcmp(CHAR(stat), viewsummary_names[k]) == 0)
+				return k;
+	}
+	error("'stats' must be a subset of \"min\", \"max\", \"sum\", "
+	      "\"mean\", \"which.min\", and \"which.max\"");
+	return -1;
+}
+
+/* Walk the runs that overlap with the view starting at 'start' and of width
+   'width' > 0. '*index', '*upper_run', and '*lengths_elt' are the run cursor,
+   shared across views like in the C_view*_RleViews() functions above. */
+static void summarize_view(SEXP values, const int *lengths_p, int nrun,
+		int start, int width, int na_rm,
+		int *index, int *upper_run, ViewSummary *summary)
+{
+	int max_index, lower_run, lower_bound, upper_bound, overlap, v_is_na;
+	double v;
+
+	summary->is_na = 0;
+	summary->min = R_PosInf;
+	summary->max = R_NegInf;
+	summary->sum = 0;
+	summary->n = width;
+	summary->which_min = summary->which_max = NA_INTEGER;
+	max_index = nrun - 1;
+	while (*index > 0 && *upper_run > start) {
+		*upper_run -= lengths_p[*index];
+		(*index)--;
+	}
+	while (*upper_run < start) {
+		(*index)++;
+		*upper_run += lengths_p[*index];
+	}
+	lower_run = *upper_run - lengths_p[*index] + 1;
+	lower_bound = start;
+	upper_bound = start + width - 1;
+	while (lower_run <= upper_bound) {
+		overlap = 1 + (upper_bound < *upper_run ?
+			       upper_bound : *upper_run) -
+			      (lower_bound > lower_run ?
+			       lower_bound : lower_run);
+		if (TYPEOF(values) == REALSXP) {
+			v = REAL(values)[*index];
+			v_is_na = ISNAN(v);
+		} else {
+			v_is_na = INTEGER(values)[*index] == NA_INTEGER;
+			v = (double) INTEGER(values)[*index];
+		}
+		if (v_is_na) {
+			if (!na_rm) {
+				summary->is_na = 1;
+				break;
+			}
+			summary->n -= overlap;
+		} else {
+			/* Seed the running min and max with the 1st non-NA
+			   value: an integer view whose extremum is
+			   +/-.Machine$integer.max must not be compared with
+			   a sentinel. */
+			if (summary->which_min == NA_INTEGER ||
+			    v < summary->min) {
+				summary->min = v;
+				summary->which_min = lower_bound;
+			}
+			if (summary->which_max == NA_INTEGER ||
+			    v > summary->max) {
+				summary->max = v;
+				summary->which_max = lower_bound;
+			}
+			summary->sum += v * overlap;
+		}
+		if (*index >= max_index)
+			break;
+		(*index)++;
+		lower_run = *upper_run + 1;
+		lower_bound = lower_run;
+		*upper_run += lengths_p[*index];
+	}
+	return;
+}
+
+static void set_int_from_double(int *out, double v, double na_fallback)
+{
+	if (v == na_fallback)
+		*out = v > 0 ? INT_MAX : R_INT_MIN;
+	else
+		*out = (int) v;
+	return;
+}
+
+/* --- .Call ENTRY POINT ---
+ * 'stats' must be a character vector containing a subset of "min", "max",
+ * "sum", "mean", "which.min", and "which.max". Returns a named list with
+ * one unnamed summary vector per requested statistic (in the order specified
+ * by 'stats').
+ */
+SEXP C_viewSummaries_RleViews(SEXP x, SEXP stats, SEXP na_rm)
+{
+	int is_int, nstats, ans_len, k, i, start, width, index, upper_run;
+	int codes[VIEWSUMMARY_NSTATS];
+	double v;
+	SEXP ans, ans_names, ans_elt, subject, values, lengths, ranges;
+	IRanges_holder ranges_holder;
+	ViewSummary summary;
+
+	subject = GET_SLOT(x, install("subject"));
+	values = GET_SLOT(subject, install("values"));
+	lengths = GET_SLOT(subject, install("lengths"));
+	ranges = GET_SLOT(x, install("ranges"));
+	ranges_holder = _hold_IRanges(ranges);
+	ans_len = _get_length_from_IRanges_holder(&ranges_holder);
+
+	switch (TYPEOF(values)) {
+	    case LGLSXP:
+	    case INTSXP:
+		is_int = 1;
+		break;
+	    case REALSXP:
+		is_int = 0;
+		break;
+	    default:
+		error("Rle must contain either 'integer' or 'numeric' values");
+	}
+	if (!IS_LOGICAL(na_rm) || LENGTH(na_rm) != 1 || LOGICAL(na_rm)[0] == NA_LOGICAL)
+		error("'na.rm' must be TRUE or FALSE");
+	if (!IS_CHARACTER(stats))
+		error("'stats' must be a character vector");
+	nstats = LENGTH(stats);
+	if (nstats > VIEWSUMMARY_NSTATS)
+		error("'stats' cannot contain duplicated values");
+	for (k = 0; k < nstats; k++)
+		codes[k] = get_viewsummary_code(STRING_ELT(stats, k));
+
+	PROTECT(ans = NEW_LIST(nstats));
+	PROTECT(ans_names = NEW_CHARACTER(nstats));
+	for (k = 0; k < nstats; k++) {
+		SET_STRING_ELT(ans_names, k,
+			       mkChar(viewsummary_names[codes[k]]));
+		switch (codes[k]) {
+		    case VIEWSUMMARY_MIN:
+		    case VIEWSUMMARY_MAX:
+		    case VIEWSUMMARY_SUM:
+			ans_elt = is_int ? NEW_INTEGER(ans_len) :
+					   NEW_NUMERIC(ans_len);
+			break;
+		    case VIEWSUMMARY_MEAN:
+			ans_elt = NEW_NUMERIC(ans_len);
+			break;
+		    default:
+			ans_elt = NEW_INTEGER(ans_len);
+		}
+		SET_VECTOR_ELT(ans, k, ans_elt);
+	}
+	SET_NAMES(ans, ans_names);
+	UNPROTECT(1);
+
+	index = 0;
+	upper_run = LENGTH(lengths) != 0 ? INTEGER(lengths)[0] : 0;
+	for (i = 0; i < ans_len; i++) {
+		if (i % 100000 == 99999)
+			R_CheckUserInterrupt();
+		start = _get_start_elt_from_IRanges_holder(&ranges_holder, i);
+		width = _get_width_elt_from_IRanges_holder(&ranges_holder, i);
+		if (width > 0) {
+			summarize_view(values, INTEGER(lengths),
+				       LENGTH(lengths), start, width,
+				       LOGICAL(na_rm)[0],
+				       &index, &upper_run, &summary);
+		} else {
+			summary.is_na = 0;
+			summary.min = R_PosInf;
+			summary.max = R_NegInf;
+			summary.sum = 0;
+			summary.n = 0;
+			summary.which_min = summary.which_max = NA_INTEGER;
+		}
+		for (k = 0; k < nstats; k++) {
+			ans_elt = VECTOR_ELT(ans, k);
+			switch (codes[k]) {
+			    case VIEWSUMMARY_MIN:
+			    case VIEWSUMMARY_MAX:
+				v = codes[k] == VIEWSUMMARY_MIN ?
+				    summary.min : summary.max;
+				if (!is_int) {
+					REAL(ans_elt)[i] = summary.is_na ?
+							   NA_REAL : v;
+				} else if (summary.is_na) {
+					INTEGER(ans_elt)[i] = NA_INTEGER;
+				} else {
+					set_int_from_double(INTEGER(ans_elt) + i,
+						v, codes[k] == VIEWSUMMARY_MIN ?
+						   R_PosInf : R_NegInf);
+				}
+				break;
+			    case VIEWSUMMARY_SUM:
+				if (!is_int) {
+					REAL(ans_elt)[i] = summary.is_na ?
+							   NA_REAL : summary.sum;
+				} else if (summary.is_na) {
+					INTEGER(ans_elt)[i] = NA_INTEGER;
+				} else {
+					if (summary.sum > INT_MAX ||
+					    summary.sum < R_INT_MIN)
+						error("Integer overflow");
+					INTEGER(ans_elt)[i] = (int) summary.sum;
+				}
+				break;
+			    case VIEWSUMMARY_MEAN:
+				if (summary.is_na)
+					REAL(ans_elt)[i] = NA_REAL;
+				else if (summary.n == 0)
+					REAL(ans_elt)[i] = R_NaN;
+				else
+					REAL(ans_elt)[i] = summary.sum /
+							   summary.n;
+				break;
+			    case VIEWSUMMARY_WHICH_MIN:
+				INTEGER(ans_elt)[i] = summary.which_min;
+				break;
+			    case VIEWSUMMARY_WHICH_MAX:
+				INTEGER(ans_elt)[i] = summary.which_max;
+				break;
+			}
+		}
+	}
+	UNPROTECT(1);
+	return ans;
+}
+
+
+/****************************************************************************
+ * View summaries of all the elements of an RleViewsList in one call
+ *
+ * Summarizing an RleViewsList in R means extracting each RleViews element,
+ * dispatching on it, trimming it, and making a .Call for each element. For
+ * coverage over thousands of contigs or scaffolds, this overhead dominates.
+ * The functions below walk the list in C and call the C_view*_RleViews()
+ * function for the requested summary directly on each element.
+ */
+
+/* Return 1 if all the views in 'x' (an RleViews object) are within the
+   bounds of its subject, that is, if trim() would be a no-op on 'x'. */
+static int views_are_within_subject(SEXP x)
+{
+	SEXP subject, lengths, ranges;
+	IRanges_holder ranges_holder;
+	int nview, i, start, width, k;
+	double subject_len;
+
+	subject = GET_SLOT(x, install("subject"));
+	lengths = GET_SLOT(subject, install("lengths"));
+	ranges = GET_SLOT(x, install("ranges"));
+	ranges_holder = _hold_IRanges(ranges);
+	nview = _get_length_from_IRanges_holder(&ranges_holder);
+	subject_len = 0;
+	for (k = 0; k < LENGTH(lengths); k++)
+		subject_len += INTEGER(lengths)[k];
+	for (i = 0; i < nview; i++) {
+		start = _get_start_elt_from_IRanges_holder(&ranges_holder, i);
+		width = _get_width_elt_from_IRanges_holder(&ranges_holder, i);
+		if (start < 1 || (double) start + width - 1 > subject_len)
+			return 0;
+	}
+	return 1;
+}
+
+static SEXP summarize_RleViews(SEXP x, int code, SEXP na_rm)
+{
+	switch (code) {
+	    case VIEWSUMMARY_MIN: return C_viewMins_RleViews(x, na_rm);
+	    case VIEWSUMMARY_MAX: return C_viewMaxs_RleViews(x, na_rm);
+	    case VIEWSUMMARY_SUM: return C_viewSums_RleViews(x, na_rm);
+	    case VIEWSUMMARY_MEAN: return C_viewMeans_RleViews(x, na_rm);
+	    case VIEWSUMMARY_WHICH_MIN:
+		return C_viewWhichMins_RleViews(x, na_rm);
+	    case VIEWSUMMARY_WHICH_MAX:
+		return C_viewWhichMaxs_RleViews(x, na_rm);
+	}
+	return R_NilValue;
+}
+
+/* --- .Call ENTRY POINT ---
+ * 'x_listData': the list of RleViews objects of an RleViewsList.
+ * 'summary': "min", "max", "sum", "mean", "which.min", or "which.max".
+ * Returns a list parallel to 'x_listData'. Elements with views that go
+ * beyond the bounds of their subject are set to NULL and are expected to be
+ * summarized at the R level (after trimming).
+ */
+SEXP C_viewSummary_RleViewsList(SEXP x_listData, SEXP summary, SEXP na_rm)
+{
+	SEXP ans, x_elt;
+	int x_len, code, i;
+
+	if (!IS_CHARACTER(summary) || LENGTH(summary) != 1)
+		error("'summary' must be a single string");
+	code = get_viewsummary_code(STRING_ELT(summary, 0));
+	if (!IS_LOGICAL(na_rm) || LENGTH(na_rm) != 1 || LOGICAL(na_rm)[0] == NA_LOGICAL)
+		error("'na.rm' must be TRUE or FALSE");
+	x_len = LENGTH(x_listData);
+	PROTECT(ans = NEW_LIST(x_len));
+	for (i = 0; i < x_len; i++) {
+		x_elt = VECTOR_ELT(x_listData, i);
+		if (!views_are_within_subject(x_elt))
+			continue;
+		SET_VECTOR_ELT(ans, i, summarize_RleViews(x_elt, code, na_rm));
+	}
+	UNPROTECT(1);
+	return ans;
+}
+
+
+/****************************************************************************
+ * Compiled kernels for viewApply() on an RleViews object
+ *
+ * Each view is summarized from the (value, count) pairs of the runs it
+ * overlaps, without extracting the view. The median and quantiles sort
+ * these pairs (so the cost depends on the number of runs in the view, not on
+ * its width).
+ */
+
+#define	VIEWAPPLY_MEDIAN	0
+#define	VIEWAPPLY_QUANTILE	1
+#define	VIEWAPPLY_VAR		2
+#define	VIEWAPPLY_SD		3
+#define	VIEWAPPLY_WEIGHTED_MEAN	4
+#define	VIEWAPPLY_COUNT_ABOVE	5
+#define	VIEWAPPLY_COUNT_BELOW	6
+#define	VIEWAPPLY_NRUN		7
+#define	VIEWAPPLY_NKERNELS	8
+
+static const char *viewapply_kernel_names[] = {
+	"median", "quantile", "var", "sd", "weighted.mean",
+	"count.above", "count.below", "nrun"
+};
+
+static int get_viewapply_kernel_code(SEXP kernel)
+{
+	int k;
+
+	if (!IS_CHARACTER(kernel) || LENGTH(kernel) != 1
+	 || STRING_ELT(kernel, 0) == NA_STRING)
+		error("'kernel' must be a single string");
+	for (k = 0; k < VIEWAPPLY_NKERNELS; k++)
+		if (strcmp(CHAR(STRING_ELT(kernel, 0)),
+			   viewapply_kernel_names[k]) == 0)
+			return k;
+	error("unsupported viewApply() kernel: \"%s\"",
+	      CHAR(STRING_ELT(kernel, 0)));
+	return -1;
+}
+
+typedef struct rle_runs {
+	int nrun;
+	double *values;		/* NAs are NA_REAL */
+	long long int *run_ends;
+} RleRuns;
+
+static RleRuns get_RleRuns(SEXP x)
+{
+	RleRuns runs;
+	SEXP values, lengths;
+	int k, is_int, v;
+	long long int end;
+
+	values = GET_SLOT(x, install("values"));
+	lengths = GET_SLOT(x, install("lengths"));
+	switch (TYPEOF(values)) {
+	    case LGLSXP: case INTSXP: is_int = 1; break;
+	    case REALSXP: is_int = 0; break;
+	    default:
+		error("Rle must contain either 'integer' or 'numeric' values");
+	}
+	runs.nrun = LENGTH(lengths);
+	runs.values = (double *) R_alloc((long) runs.nrun, sizeof(double));
+	runs.run_ends = (long long int *) R_alloc((long) runs.nrun,
+						  sizeof(long long int));
+	end = 0;
+	for (k = 0; k < runs.nrun; k++) {
+		end += INTEGER(lengths)[k];
+		runs.run_ends[k] = end;
+		if (is_int) {
+			v = INTEGER(values)[k];
+			runs.values[k] = v == NA_INTEGER ? NA_REAL : (double) v;
+		} else {
+			runs.values[k] = REAL(values)[k];
+		}
+	}
+	return runs;
+}
+
+/* Index of the run that contains position 'pos'. */
+static int find_run_in_RleRuns(const RleRuns *runs, long long int pos)
+{
+	int lo, hi, mid;
+
+	lo = 0;
+	hi = runs->nrun - 1;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (runs->run_ends[mid] < pos)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/* Number of positions of run 'k' that are in ['start', 'end']. */
+static int run_overlap(const RleRuns *runs, int k,
+		long long int start, long long int end)
+{
+	long long int run_start, run_end;
+
+	run_end = runs->run_ends[k];
+	run_start = k == 0 ? 1 : runs->run_ends[k - 1] + 1;
+	if (run_start < start)
+		run_start = start;
+	if (run_end > end)
+		run_end = end;
+	return (int) (run_end - run_start + 1);
+}
+
+/* Value at 0-based position 'i' of the sorted view described by the
+   'nval' (value, count) pairs, sorted by value. */
+static double nth_sorted_value(const double *vals, const int *counts,
+		int nval, long long int i)
+{
+	int k;
+
+	for (k = 0; k < nval - 1; k++) {
+		if (i < counts[k])
+			break;
+		i -= counts[k];
+	}
+	return vals[k];
+}
+
+/* Same as quantile(x, probs=p, type=7) on the sorted view of length 'n'. */
+static double sorted_quantile(const double *vals, const int *counts,
+		int nval, long long int n, double p)
+{
+	double index, h, qs, x_hi;
+	long long int lo, hi;
+
+	index = 1.0 + (double) (n - 1) * p;
+	lo = (long long int) floor(index);
+	hi = (long long int) ceil(index);
+	qs = nth_sorted_value(vals, counts, nval, lo - 1);
+	if (index > lo) {
+		x_hi = nth_sorted_value(vals, counts, nval, hi - 1);
+		if (x_hi != qs) {
+			h = index - lo;
+			qs = (1 - h) * qs + h * x_hi;
+		}
+	}
+	return qs;
+}
+
+/* --- .Call ENTRY POINT ---
+ * 'x': a trimmed RleViews object.
+ * 'kernel': one of the strings in 'viewapply_kernel_names'.
+ * 'probs': the probabilities for "quantile" (the result is then a
+ *     length(probs) x length(x) matrix).
+ * 'threshold': the threshold for "count.above" and "count.below".
+ * 'w': an Rle of weights, parallel to the subject of 'x', for
+ *     "weighted.mean".
+ * Like sapply(views, stats::median), "median" returns an integer vector
+ * when the subject is integer and no view has an even number of non-NA
+ * values.
+ */
+SEXP C_viewApply_RleViews(SEXP x, SEXP kernel, SEXP probs, SEXP threshold,
+		SEXP w, SEXP na_rm)
+{
+	SEXP subject, ranges, ans;
+	IRanges_holder ranges_holder;
+	RleRuns runs, w_runs;
+	int code, narm, nview, nprobs, nval, i, j, k, k1, k2, count, has_na,
+	    *counts, ans_is_int, median_is_int;
+	long long int start, end, n, wpos, wend;
+	double *vals, v, thr, mean;
+	long double sum, sumsq, wsum, wtot;
+
+	code = get_viewapply_kernel_code(kernel);
+	if (!IS_LOGICAL(na_rm) || LENGTH(na_rm) != 1 || LOGICAL(na_rm)[0] == NA_LOGICAL)
+		error("'na.rm' must be TRUE or FALSE");
+	narm = LOGICAL(na_rm)[0];
+	subject = GET_SLOT(x, install("subject"));
+	ranges = GET_SLOT(x, install("ranges"));
+	ranges_holder = _hold_IRanges(ranges);
+	nview = _get_length_from_IRanges_holder(&ranges_holder);
+	runs = get_RleRuns(subject);
+	median_is_int = code == VIEWAPPLY_MEDIAN &&
+		TYPEOF(GET_SLOT(subject, install("values"))) == INTSXP;
+	nprobs = code == VIEWAPPLY_QUANTILE ? LENGTH(probs) : 1;
+	thr = 0.0;
+	if (code == VIEWAPPLY_COUNT_ABOVE || code == VIEWAPPLY_COUNT_BELOW) {
+		if (!IS_NUMERIC(threshold) || LENGTH(threshold) != 1
+		 || ISNAN(REAL(threshold)[0]))
+			error("'threshold' must be a single number");
+		thr = REAL(threshold)[0];
+	}
+	if (code == VIEWAPPLY_WEIGHTED_MEAN)
+		w_runs = get_RleRuns(w);
+	vals = (double *) R_alloc((long) runs.nrun, sizeof(double));
+	counts = (int *) R_alloc((long) runs.nrun, sizeof(int));
+	ans_is_int = code == VIEWAPPLY_COUNT_ABOVE ||
+		     code == VIEWAPPLY_COUNT_BELOW ||
+		     code == VIEWAPPLY_NRUN;
+	if (code == VIEWAPPLY_QUANTILE)
+		PROTECT(ans = allocMatrix(REALSXP, nprobs, nview));
+	else if (ans_is_int)
+		PROTECT(ans = NEW_INTEGER(nview));
+	else
+		PROTECT(ans = NEW_NUMERIC(nview));
+	for (i = 0; i < nview; i++) {
+		if (i % 100000 == 99999)
+			R_CheckUserInterrupt();
+		start = _get_start_elt_from_IRanges_holder(&ranges_holder, i);
+		end = start - 1 +
+		      _get_width_elt_from_IRanges_holder(&ranges_holder, i);
+		if (end < start) {
+			k1 = 0;
+			k2 = -1;
+		} else {
+			k1 = find_run_in_RleRuns(&runs, start);
+			k2 = find_run_in_RleRuns(&runs, end);
+		}
+		if (code == VIEWAPPLY_NRUN) {
+			INTEGER(ans)[i] = k2 - k1 + 1;
+			continue;
+		}
+		if (code == VIEWAPPLY_WEIGHTED_MEAN) {
+			/* Walk the runs of the subject and of 'w' in
+			   parallel. */
+			wsum = wtot = 0.0;
+			has_na = 0;
+			if (k1 <= k2) {
+				j = find_run_in_RleRuns(&w_runs, start);
+				k = k1;
+				wpos = start;
+				while (wpos <= end) {
+					wend = runs.run_ends[k];
+					if (w_runs.run_ends[j] < wend)
+						wend = w_runs.run_ends[j];
+					if (wend > end)
+						wend = end;
+					count = (int) (wend - wpos + 1);
+					v = runs.values[k];
+					if (w_runs.values[j] == 0) {
+						/* stats::weighted.mean() drops
+						   the zero-weight terms before
+						   looking at the values. */
+					} else if (ISNAN(v)) {
+						if (!narm)
+							has_na = 1;
+					} else {
+						wsum += (long double) v *
+							w_runs.values[j] * count;
+						wtot += (long double)
+							w_runs.values[j] * count;
+					}
+					if (runs.run_ends[k] == wend)
+						k++;
+					if (w_runs.run_ends[j] == wend)
+						j++;
+					wpos = wend + 1;
+				}
+			}
+			REAL(ans)[i] = has_na ? NA_REAL :
+				       (double) (wsum / wtot);
+			continue;
+		}
+		/* Collect the (value, count) pairs of the view. */
+		nval = 0;
+		n = 0;
+		has_na = 0;
+		for (k = k1; k <= k2; k++) {
+			v = runs.values[k];
+			if (ISNAN(v)) {
+				if (!narm)
+					has_na = 1;
+				continue;
+			}
+			vals[nval] = v;
+			counts[nval] = run_overlap(&runs, k, start, end);
+			n += counts[nval];
+			nval++;
+		}
+		switch (code) {
+		    case VIEWAPPLY_COUNT_ABOVE:
+		    case VIEWAPPLY_COUNT_BELOW:
+			if (has_na) {
+				INTEGER(ans)[i] = NA_INTEGER;
+				break;
+			}
+			count = 0;
+			for (k = 0; k < nval; k++) {
+				if (code == VIEWAPPLY_COUNT_ABOVE ?
+				    vals[k] > thr : vals[k] < thr)
+					count += counts[k];
+			}
+			INTEGER(ans)[i] = count;
+			break;
+		    case VIEWAPPLY_VAR:
+		    case VIEWAPPLY_SD:
+			if (has_na || n < 2) {
+				REAL(ans)[i] = NA_REAL;
+				break;
+			}
+			sum = 0.0;
+			for (k = 0; k < nval; k++)
+				sum += (long double) vals[k] * counts[k];
+			mean = (double) (sum / n);
+			sumsq = 0.0;
+			for (k = 0; k < nval; k++)
+				sumsq += (long double) (vals[k] - mean) *
+					 (vals[k] - mean) * counts[k];
+			v = (double) (sumsq / (n - 1));
+			REAL(ans)[i] = code == VIEWAPPLY_SD ? sqrt(v) : v;
+			break;
+		    case VIEWAPPLY_MEDIAN:
+			if (has_na || n == 0) {
+				REAL(ans)[i] = NA_REAL;
+				break;
+			}
+			rsort_with_index(vals, counts, nval);
+			if (n % 2 == 0)
+				median_is_int = 0;
+			if (n % 2 == 1) {
+				REAL(ans)[i] = nth_sorted_value(vals, counts,
+							nval, n / 2);
+			} else {
+				REAL(ans)[i] = (nth_sorted_value(vals, counts,
+							nval, n / 2 - 1) +
+						nth_sorted_value(vals, counts,
+							nval, n / 2)) / 2;
+			}
+			break;
+		    case VIEWAPPLY_QUANTILE:
+			if (has_na)
+				error("missing values and NaN's not allowed "
+				      "if 'na.rm' is FALSE");
+			if (n != 0)
+				rsort_with_index(vals, counts, nval);
+			for (j = 0; j < nprobs; j++) {
+				REAL(ans)[(long) i * nprobs + j] = n == 0 ?
+				    NA_REAL :
+				    sorted_quantile(vals, counts, nval, n,
+						    REAL(probs)[j]);
+			}
+			break;
+		}
+	}
+	if (median_is_int) {
+		PROTECT(ans = coerceVector(ans, INTSXP));
+		UNPROTECT(2);
+		return ans;
+	}
+	UNPROTECT(1);
+	return ans;
+}
@@ -45,6 +45,24 @@ static int append_IRanges_holder_to_IntPairAE(IntPairAE *intpair_ae,
 	return ir_len;
 }
 
+/* Returns 1 if the ranges are sorted by start first and then by width, that
+   is, if get_order_of_int_pairs() would return the identity permutation on
+   them. Returns 0 otherwise. This is a cheap linear pre-pass that allows
+   reduce_ranges() and gaps_ranges() to skip the ordering step on
+   coordinate-sorted input (the typical situation with aligned reads). */
+static int int_pairs_are_sorted(const int *a, const int *b, int nelt)
+{
+	int i;
+
+	for (i = 1; i < nelt; i++) {
+		if (a[i] < a[i - 1])
+			return 0;
+		if (a[i] == a[i - 1] && b[i] < b[i - 1])
+			return 0;
+	}
+	return 1;
+}
+
 
 /****************************************************************************
  * range() method for IRanges objects
@@ -53,7 +71,7 @@ static int append_IRanges_holder_to_IntPairAE(IntPairAE *intpair_ae,
 /* --- .Call ENTRY POINT --- */
 SEXP C_range_IRanges(SEXP x)
 {
-	int x_len, min, max, i, end;
+	int x_len, min, max, i, start, end;
 	const int *start_p, *width_p;
 	SEXP ans, ans_start, ans_width;
 
@@ -68,15 +86,16 @@ SEXP C_range_IRanges(SEXP x)
 	}
 	start_p = INTEGER(_get_IRanges_start(x));
 	width_p = INTEGER(_get_IRanges_width(x));
-	min = *(start_p++);
-	max = min + *(width_p++) - 1;
-	for (i = 1; i < x_len; i++, start_p++, width_p++)
-	{
-		if (*start_p < min)
-			min = *start_p;
-		end = *start_p + *width_p - 1;
-		if (end > max)
-			max = end;
+	/* Branch-free min/max reduction. Written this way (no pointer
+	   arithmetic, no data-dependent branches) so the compiler can
+	   auto-vectorize it. */
+	min = start_p[0];
+	max = start_p[0] + width_p[0] - 1;
+	for (i = 1; i < x_len; i++) {
+		start = start_p[i];
+		end = start + width_p[i] - 1;
+		min = start < min ? start : min;
+		max = end > max ? end : max;
 	}
 	PROTECT(ans_start = ScalarInteger(min));
 	PROTECT(ans_width = ScalarInteger(max - min + 1));
@@ -92,7 +111,8 @@ SEXP C_range_IRanges(SEXP x)
  */
 
 /* WARNING: The reduced ranges are *appended* to 'out_ranges'!
-   Returns the number of ranges that were appended. */
+   Returns the number of ranges that were appended.
+   'order_buf' is not used if the input ranges are already sorted. */
 static int reduce_ranges(const int *x_start, const int *x_width, int x_len,
 		int drop_empty_ranges, int min_gapwidth,
 		int *order_buf, IntPairAE *out_ranges,
@@ -105,10 +125,14 @@ static int reduce_ranges(const int *x_start, const int *x_width, int x_len,
 	if (min_gapwidth < 0)
 		error("IRanges internal error in reduce_ranges(): "
 		      "negative min_gapwidth not supported");
-	get_order_of_int_pairs(x_start, x_width, x_len, 0, 0, order_buf, 0);
+	if (int_pairs_are_sorted(x_start, x_width, x_len))
+		order_buf = NULL;
+	else
+		get_order_of_int_pairs(x_start, x_width, x_len, 0, 0,
+				       order_buf, 0);
 	out_len = out_len0 = IntPairAE_get_nelt(out_ranges);
 	for (i = 0; i < x_len; i++) {
-		j = order_buf[i];
+		j = order_buf == NULL ? i : order_buf[i];
 		start_j = x_start[j];
 		width_j = x_width[j];
 		end_j = start_j + width_j - 1;
@@ -297,12 +321,173 @@ SEXP C_reduce_CompressedIRangesList(SEXP x, SEXP drop_empty_ranges,
 }
 
 
+/****************************************************************************
+ * Streaming reduce() on sorted chunks
+ *
+ * Same merge logic as reduce_ranges() (without 'revmap' or 'inframe_start'
+ * support) but applied to input that arrives in chunks already sorted by
+ * start then width. The only thing kept between chunks is the state below,
+ * which includes the one "open" range i.e. the last appended range. This
+ * range is not emitted until it can no longer be extended.
+ */
+
+#define	REDUCER_STARTED		0
+#define	REDUCER_APPEND_OR_DROP	1
+#define	REDUCER_MAX_END		2
+#define	REDUCER_OPEN_START	3  /* NA if no range was appended yet */
+#define	REDUCER_OPEN_WIDTH	4
+#define	REDUCER_OPEN_EMITTED	5
+#define	REDUCER_LAST_START	6  /* start of last input range */
+#define	REDUCER_LAST_WIDTH	7  /* width of last input range */
+#define	REDUCER_STATE_LEN	8
+
+static void init_reducer_state(int *state)
+{
+	state[REDUCER_STARTED] = 0;
+	state[REDUCER_APPEND_OR_DROP] = 1;
+	state[REDUCER_MAX_END] = 0;
+	state[REDUCER_OPEN_START] = NA_INTEGER;
+	state[REDUCER_OPEN_WIDTH] = 0;
+	state[REDUCER_OPEN_EMITTED] = 0;
+	state[REDUCER_LAST_START] = NA_INTEGER;
+	state[REDUCER_LAST_WIDTH] = NA_INTEGER;
+	return;
+}
+
+static void emit_open_range(int *state, IntPairAE *out_ranges)
+{
+	if (state[REDUCER_OPEN_START] == NA_INTEGER
+	 || state[REDUCER_OPEN_EMITTED])
+		return;
+	IntPairAE_insert_at(out_ranges, IntPairAE_get_nelt(out_ranges),
+			    state[REDUCER_OPEN_START],
+			    state[REDUCER_OPEN_WIDTH]);
+	state[REDUCER_OPEN_EMITTED] = 1;
+	return;
+}
+
+/* Returns -1 if the chunk is not sorted (or not sorted with respect to the
+   previous chunk), and 0 otherwise. Finalized ranges are appended to
+   'out_ranges'. */
+static int reduce_sorted_chunk(const int *x_start, const int *x_width,
+		int x_len, int drop_empty_ranges, int min_gapwidth,
+		int *state, IntPairAE *out_ranges)
+{
+	int i, start_i, width_i, end_i, gapwidth, width_inc;
+
+	for (i = 0; i < x_len; i++) {
+		start_i = x_start[i];
+		width_i = x_width[i];
+		end_i = start_i + width_i - 1;
+		if (!state[REDUCER_STARTED]) {
+			state[REDUCER_STARTED] = 1;
+			state[REDUCER_APPEND_OR_DROP] = 1;
+			state[REDUCER_MAX_END] = end_i;
+		} else {
+			if (start_i < state[REDUCER_LAST_START]
+			 || (start_i == state[REDUCER_LAST_START]
+			  && width_i < state[REDUCER_LAST_WIDTH]))
+				return -1;
+			gapwidth = start_i - state[REDUCER_MAX_END] - 1;
+			if (gapwidth >= min_gapwidth)
+				state[REDUCER_APPEND_OR_DROP] = 1;
+		}
+		state[REDUCER_LAST_START] = start_i;
+		state[REDUCER_LAST_WIDTH] = width_i;
+		if (state[REDUCER_APPEND_OR_DROP]) {
+			if (width_i != 0
+			 || (!drop_empty_ranges
+			     && (state[REDUCER_OPEN_START] == NA_INTEGER
+				 || start_i != state[REDUCER_OPEN_START])))
+			{
+				/* The open range is final. Replace it. */
+				emit_open_range(state, out_ranges);
+				state[REDUCER_OPEN_START] = start_i;
+				state[REDUCER_OPEN_WIDTH] = width_i;
+				state[REDUCER_OPEN_EMITTED] = 0;
+				state[REDUCER_APPEND_OR_DROP] = 0;
+			}
+			state[REDUCER_MAX_END] = end_i;
+		} else {
+			width_inc = end_i - state[REDUCER_MAX_END];
+			if (width_inc > 0) {
+				/* Merge with the open range. */
+				state[REDUCER_OPEN_WIDTH] += width_inc;
+				state[REDUCER_MAX_END] = end_i;
+			}
+		}
+	}
+	/* If 'append_or_drop' is set then the next range (if any) will be
+	   appended so the open range cannot be extended anymore. */
+	if (state[REDUCER_APPEND_OR_DROP])
+		emit_open_range(state, out_ranges);
+	return 0;
+}
+
+/* --- .Call ENTRY POINT ---
+ * 'state' must be NULL for the first chunk, or the "state" component of the
+ * list returned by the previous call. If 'flush' is TRUE, the open range is
+ * emitted regardless of whether it can still be extended or not.
+ * Returns a list with the starts and widths of the ranges that were
+ * finalized by this chunk, plus the new state.
+ */
+SEXP C_reduce_sorted_chunk(SEXP x_start, SEXP x_width, SEXP state,
+		SEXP drop_empty_ranges, SEXP min_gapwidth, SEXP flush)
+{
+	int x_len;
+	const int *x_start_p, *x_width_p;
+	SEXP ans, ans_names, ans_state;
+	IntPairAE *out_ranges;
+
+	x_len = check_integer_pairs(x_start, x_width,
+				    &x_start_p, &x_width_p,
+				    "start(x)", "width(x)");
+	PROTECT(ans_state = NEW_INTEGER(REDUCER_STATE_LEN));
+	if (state == R_NilValue) {
+		init_reducer_state(INTEGER(ans_state));
+	} else {
+		if (!IS_INTEGER(state) || LENGTH(state) != REDUCER_STATE_LEN)
+			error("IRanges internal error in "
+			      "C_reduce_sorted_chunk(): invalid 'state'");
+		memcpy(INTEGER(ans_state), INTEGER(state),
+		       sizeof(int) * REDUCER_STATE_LEN);
+	}
+	out_ranges = new_IntPairAE(0, 0);
+	if (reduce_sorted_chunk(x_start_p, x_width_p, x_len,
+			LOGICAL(drop_empty_ranges)[0], INTEGER(min_gapwidth)[0],
+			INTEGER(ans_state), out_ranges) != 0)
+	{
+		UNPROTECT(1);
+		error("the ranges must be sorted by start then width, "
+		      "within and across chunks");
+	}
+	if (LOGICAL(flush)[0]) {
+		emit_open_range(INTEGER(ans_state), out_ranges);
+		init_reducer_state(INTEGER(ans_state));
+	}
+
+	PROTECT(ans = NEW_LIST(3));
+	PROTECT(ans_names = NEW_CHARACTER(3));
+	SET_STRING_ELT(ans_names, 0, mkChar("start"));
+	SET_STRING_ELT(ans_names, 1, mkChar("width"));
+	SET_STRING_ELT(ans_names, 2, mkChar("state"));
+	SET_NAMES(ans, ans_names);
+	UNPROTECT(1);
+	SET_VECTOR_ELT(ans, 0, new_INTEGER_from_IntAE(out_ranges->a));
+	SET_VECTOR_ELT(ans, 1, new_INTEGER_from_IntAE(out_ranges->b));
+	SET_VECTOR_ELT(ans, 2, ans_state);
+	UNPROTECT(2);
+	return ans;
+}
+
+
 /****************************************************************************
  * gaps() methods for IntegerRanges and CompressedIRangesList objects
  */
 
 /* WARNING: The ranges representing the gaps are *appended* to 'out_ranges'!
-   Returns the number of ranges that were appended. */
+   Returns the number of ranges that were appended.
+   'order_buf' is not used if the input ranges are already sorted. */
 static int gaps_ranges(const int *x_start, const int *x_width, int x_len,
 		int restrict_start, int restrict_end,
 		int *order_buf, IntPairAE *out_ranges)
@@ -314,10 +499,14 @@ static int gaps_ranges(const int *x_start, const int *x_width, int x_len,
 		max_end = restrict_start - 1;
 	else
 		max_end = NA_INTEGER;
-	get_order_of_int_pairs(x_start, x_width, x_len, 0, 0, order_buf, 0);
+	if (int_pairs_are_sorted(x_start, x_width, x_len))
+		order_buf = NULL;
+	else
+		get_order_of_int_pairs(x_start, x_width, x_len, 0, 0,
+				       order_buf, 0);
 	out_len = out_len0 = IntPairAE_get_nelt(out_ranges);
 	for (i = 0; i < x_len; i++) {
-		j = order_buf[i];
+		j = order_buf == NULL ? i : order_buf[i];
 		width_j = x_width[j];
 		if (width_j == 0)
 			continue;
@@ -441,6 +630,308 @@ SEXP C_gaps_CompressedIRangesList(SEXP x, SEXP start, SEXP end)
 }
 
 
+/****************************************************************************
+ * union(), intersect() and setdiff() methods for IntegerRanges and
+ * CompressedIRangesList objects
+ *
+ * The 2 operands are first brought to their normal form (i.e. sorted,
+ * disjoint, non-adjacent, and non-empty ranges) with reduce_ranges(), unless
+ * _is_normal_IRanges_holder() says they are already normal in which case
+ * their ranges are used in place. The set operation itself is then a single
+ * linear sweep over the 2 normal sequences.
+ */
+
+#define UNION_SETOP	1
+#define INTERSECT_SETOP	2
+#define SETDIFF_SETOP	3
+
+static int get_setop_code(SEXP op)
+{
+	const char *op_string;
+
+	if (!IS_CHARACTER(op) || LENGTH(op) != 1
+	 || STRING_ELT(op, 0) == NA_STRING)
+		error("IRanges internal error in get_setop_code(): "
+		      "'op' must be a single string");
+	op_string = CHAR(STRING_ELT(op, 0));
+	if (strcmp(op_string, "union") == 0)
+		return UNION_SETOP;
+	if (strcmp(op_string, "intersect") == 0)
+		return INTERSECT_SETOP;
+	if (strcmp(op_string, "setdiff") == 0)
+		return SETDIFF_SETOP;
+	error("IRanges internal error in get_setop_code(): "
+	      "invalid set operation \"%s\"", op_string);
+	return 0;
+}
+
+static IRanges_holder hold_integer_pairs(const int *start, const int *width,
+		int len)
+{
+	IRanges_holder x_holder;
+
+	x_holder.classname = "IRanges";
+	x_holder.is_constant_width = 0;
+	x_holder.length = len;
+	x_holder.width = width;
+	x_holder.start = start;
+	x_holder.end = NULL;
+	x_holder.SEXP_offset = 0;
+	x_holder.names = R_NilValue;
+	return x_holder;
+}
+
+/* Sets '*start' and '*width' to point to the normal form of the ranges in
+   'x_holder' and returns its length. 'in_ranges', 'norm_ranges', and
+   'order_buf' are only used if 'x_holder' is not already normal, in which
+   case the returned pointers are only valid until the next call that uses
+   'norm_ranges'.
+   If 'sorted_is_enough' is TRUE, ranges that are only sorted (by start then
+   width) are also used in place. The union sweep below can consume those
+   directly. */
+static int hold_normal_ranges(const IRanges_holder *x_holder,
+		int sorted_is_enough,
+		int *order_buf, IntPairAE *in_ranges, IntPairAE *norm_ranges,
+		const int **start, const int **width)
+{
+	int x_len;
+
+	x_len = _get_length_from_IRanges_holder(x_holder);
+	if (x_holder->start != NULL && !x_holder->is_constant_width
+	 && (sorted_is_enough ?
+		int_pairs_are_sorted(x_holder->start, x_holder->width, x_len) :
+		_is_normal_IRanges_holder(x_holder)))
+	{
+		*start = x_holder->start;
+		*width = x_holder->width;
+		return x_len;
+	}
+	IntPairAE_set_nelt(in_ranges, 0);
+	append_IRanges_holder_to_IntPairAE(in_ranges, x_holder);
+	IntPairAE_set_nelt(norm_ranges, 0);
+	reduce_ranges(in_ranges->a->elts, in_ranges->b->elts,
+		      IntPairAE_get_nelt(in_ranges), 1, 1,
+		      order_buf, norm_ranges, NULL, NULL);
+	*start = norm_ranges->a->elts;
+	*width = norm_ranges->b->elts;
+	return IntPairAE_get_nelt(norm_ranges);
+}
+
+static void append_start_end(IntPairAE *out_ranges, int start, int end)
+{
+	IntPairAE_insert_at(out_ranges, IntPairAE_get_nelt(out_ranges),
+			    start, end - start + 1);
+}
+
+/* WARNING: The resulting ranges are *appended* to 'out_ranges'!
+   The 2 input sequences must be normal, except for UNION_SETOP where it's
+   enough that they are sorted by start. The output sequence is normal. */
+static void setop_normal_ranges(int op,
+		const int *x_start, const int *x_width, int x_len,
+		const int *y_start, const int *y_width, int y_len,
+		IntPairAE *out_ranges)
+{
+	int i, j, is_open, open_start, open_end, start, end, x_end, y_end,
+	    remains;
+
+	i = j = 0;
+	switch (op) {
+	    case UNION_SETOP:
+		/* Merge the 2 sequences by start and fuse overlapping or
+		   adjacent ranges on the fly. Empty ranges are dropped. */
+		is_open = 0;
+		while (i < x_len || j < y_len) {
+			if (j >= y_len
+			 || (i < x_len && x_start[i] <= y_start[j]))
+			{
+				start = x_start[i];
+				end = start + x_width[i] - 1;
+				i++;
+			} else {
+				start = y_start[j];
+				end = start + y_width[j] - 1;
+				j++;
+			}
+			if (end < start)
+				continue;
+			if (is_open && start - 1 <= open_end) {
+				if (end > open_end)
+					open_end = end;
+				continue;
+			}
+			if (is_open)
+				append_start_end(out_ranges,
+						 open_start, open_end);
+			open_start = start;
+			open_end = end;
+			is_open = 1;
+		}
+		if (is_open)
+			append_start_end(out_ranges, open_start, open_end);
+		break;
+	    case INTERSECT_SETOP:
+		while (i < x_len && j < y_len) {
+			x_end = x_start[i] + x_width[i] - 1;
+			y_end = y_start[j] + y_width[j] - 1;
+			start = x_start[i] > y_start[j] ?
+				x_start[i] : y_start[j];
+			end = x_end < y_end ? x_end : y_end;
+			if (start <= end)
+				append_start_end(out_ranges, start, end);
+			if (x_end < y_end)
+				i++;
+			else
+				j++;
+		}
+		break;
+	    case SETDIFF_SETOP:
+		for (i = 0; i < x_len; i++) {
+			start = x_start[i];
+			x_end = start + x_width[i] - 1;
+			/* Skip the ranges in 'y' that end before the current
+			   range in 'x'. */
+			while (j < y_len && y_start[j] + y_width[j] - 1 < start)
+				j++;
+			remains = 1;
+			for ( ; j < y_len && y_start[j] <= x_end; j++) {
+				if (y_start[j] > start)
+					append_start_end(out_ranges,
+							 start, y_start[j] - 1);
+				y_end = y_start[j] + y_width[j] - 1;
+				if (y_end >= x_end) {
+					/* 'y[j]' can also overlap with the
+					   next range in 'x' so we keep it. */
+					remains = 0;
+					break;
+				}
+				start = y_end + 1;
+			}
+			if (remains)
+				append_start_end(out_ranges, start, x_end);
+		}
+		break;
+	}
+	return;
+}
+
+/* --- .Call ENTRY POINT --- */
+SEXP C_setop_IntegerRanges(SEXP x_start, SEXP x_width,
+		SEXP y_start, SEXP y_width, SEXP op)
+{
+	int op0, x_len, y_len, nx, ny;
+	const int *x_start_p, *x_width_p, *y_start_p, *y_width_p,
+		  *nx_start, *nx_width, *ny_start, *ny_width;
+	IRanges_holder x_holder, y_holder;
+	IntAE *order_buf;
+	IntPairAE *in_ranges, *x_norm_ranges, *y_norm_ranges, *out_ranges;
+	SEXP ans, ans_names;
+
+	op0 = get_setop_code(op);
+	x_len = check_integer_pairs(x_start, x_width,
+				    &x_start_p, &x_width_p,
+				    "start(x)", "width(x)");
+	y_len = check_integer_pairs(y_start, y_width,
+				    &y_start_p, &y_width_p,
+				    "start(y)", "width(y)");
+	x_holder = hold_integer_pairs(x_start_p, x_width_p, x_len);
+	y_holder = hold_integer_pairs(y_start_p, y_width_p, y_len);
+	order_buf = new_IntAE(x_len >= y_len ? x_len : y_len, 0, 0);
+	in_ranges = new_IntPairAE(0, 0);
+	x_norm_ranges = new_IntPairAE(0, 0);
+	y_norm_ranges = new_IntPairAE(0, 0);
+	out_ranges = new_IntPairAE(0, 0);
+	nx = hold_normal_ranges(&x_holder, op0 == UNION_SETOP,
+				order_buf->elts,
+				in_ranges, x_norm_ranges,
+				&nx_start, &nx_width);
+	ny = hold_normal_ranges(&y_holder, op0 == UNION_SETOP,
+				order_buf->elts,
+				in_ranges, y_norm_ranges,
+				&ny_start, &ny_width);
+	setop_normal_ranges(op0, nx_start, nx_width, nx,
+				 ny_start, ny_width, ny, out_ranges);
+
+	PROTECT(ans = NEW_LIST(2));
+	PROTECT(ans_names = NEW_CHARACTER(2));
+	SET_STRING_ELT(ans_names, 0, mkChar("start"));
+	SET_STRING_ELT(ans_names, 1, mkChar("width"));
+	SET_NAMES(ans, ans_names);
+	UNPROTECT(1);
+	SET_VECTOR_ELT(ans, 0, new_INTEGER_from_IntAE(out_ranges->a));
+	SET_VECTOR_ELT(ans, 1, new_INTEGER_from_IntAE(out_ranges->b));
+	UNPROTECT(1);
+	return ans;
+}
+
+/* --- .Call ENTRY POINT ---
+ * 'x' and 'y' are recycled to the length of the longest.
+ */
+SEXP C_setop_CompressedIRangesList(SEXP x, SEXP y, SEXP op)
+{
+	SEXP ans, ans_names, ans_breakpoints;
+	CompressedIRangesList_holder x_holder, y_holder;
+	IRanges_holder xi_holder, yi_holder;
+	int op0, x_len, y_len, ans_len, in_len_max, len, i, nx, ny;
+	const int *nx_start, *nx_width, *ny_start, *ny_width;
+	IntAE *order_buf;
+	IntPairAE *in_ranges, *x_norm_ranges, *y_norm_ranges, *out_ranges;
+
+	op0 = get_setop_code(op);
+	x_holder = _hold_CompressedIRangesList(x);
+	y_holder = _hold_CompressedIRangesList(y);
+	x_len = _get_length_from_CompressedIRangesList_holder(&x_holder);
+	y_len = _get_length_from_CompressedIRangesList_holder(&y_holder);
+	if (x_len == 0 || y_len == 0) {
+		if (x_len != y_len)
+			error("cannot recycle a zero-length list "
+			      "to a non-zero length");
+		ans_len = 0;
+	} else {
+		ans_len = x_len >= y_len ? x_len : y_len;
+	}
+	in_len_max = get_maxNROWS_from_CompressedIRangesList_holder(&x_holder);
+	len = get_maxNROWS_from_CompressedIRangesList_holder(&y_holder);
+	if (len > in_len_max)
+		in_len_max = len;
+	order_buf = new_IntAE(in_len_max, 0, 0);
+	in_ranges = new_IntPairAE(0, 0);
+	x_norm_ranges = new_IntPairAE(0, 0);
+	y_norm_ranges = new_IntPairAE(0, 0);
+	out_ranges = new_IntPairAE(0, 0);
+	PROTECT(ans_breakpoints = NEW_INTEGER(ans_len));
+	for (i = 0; i < ans_len; i++) {
+		xi_holder = _get_elt_from_CompressedIRangesList_holder(
+				&x_holder, i % x_len);
+		yi_holder = _get_elt_from_CompressedIRangesList_holder(
+				&y_holder, i % y_len);
+		nx = hold_normal_ranges(&xi_holder, op0 == UNION_SETOP,
+					order_buf->elts,
+					in_ranges, x_norm_ranges,
+					&nx_start, &nx_width);
+		ny = hold_normal_ranges(&yi_holder, op0 == UNION_SETOP,
+					order_buf->elts,
+					in_ranges, y_norm_ranges,
+					&ny_start, &ny_width);
+		setop_normal_ranges(op0, nx_start, nx_width, nx,
+					 ny_start, ny_width, ny, out_ranges);
+		INTEGER(ans_breakpoints)[i] = IntPairAE_get_nelt(out_ranges);
+	}
+
+	PROTECT(ans = NEW_LIST(3));
+	PROTECT(ans_names = NEW_CHARACTER(3));
+	SET_STRING_ELT(ans_names, 0, mkChar("start"));
+	SET_STRING_ELT(ans_names, 1, mkChar("width"));
+	SET_STRING_ELT(ans_names, 2, mkChar("breakpoints"));
+	SET_NAMES(ans, ans_names);
+	UNPROTECT(1);
+	SET_VECTOR_ELT(ans, 0, new_INTEGER_from_IntAE(out_ranges->a));
+	SET_VECTOR_ELT(ans, 1, new_INTEGER_from_IntAE(out_ranges->b));
+	SET_VECTOR_ELT(ans, 2, ans_breakpoints);
+	UNPROTECT(2);
+	return ans;
+}
+
+
 /****************************************************************************
  * disjointBins() method for IntegerRanges objects
  */
@@ -0,0 +1,374 @@
+/****************************************************************************
+ *                         Fast intra-range methods                         *
+ ****************************************************************************/
+#include "IRanges.h"
+#include "S4Vectors_interface.h"
+
+#include <limits.h>
+
+
+/****************************************************************************
+ * Low-level helper functions.
+ *
+ * The vectors of arguments passed to the kernels below (e.g. the 'start'
+ * and 'end' vectors of restrict() or the 'width' vector of resize()) are
+ * recycled on the fly to the length of 'x', so the R code doesn't need to
+ * recycle them first.
+ */
+
+static int check_arg_length(SEXP arg, int x_len, const char *what)
+{
+	int arg_len;
+
+	arg_len = LENGTH(arg);
+	if (x_len != 0 && arg_len == 0)
+		error("'%s' has length 0 but 'x' has not", what);
+	return arg_len;
+}
+
+/* Advances a recycling index. */
+#define NEXT_RECYCLED(j, len) \
+	do { if (++(j) >= (len)) (j) = 0; } while (0)
+
+/* Returns NA_INTEGER and sets '*ovflow' if 'v' does not fit in an int. */
+static int as_int_or_NA(long long int v, int *ovflow)
+{
+	if (v < -INT_MAX || v > INT_MAX) {
+		*ovflow = 1;
+		return NA_INTEGER;
+	}
+	return (int) v;
+}
+
+/* Floor division by 2, like '%/% 2L' in R. */
+static long long int floor_half(long long int v)
+{
+	return v >= 0 ? v / 2 : -((-v + 1) / 2);
+}
+
+static SEXP new_start_width_list(SEXP ans_start, SEXP ans_width)
+{
+	SEXP ans, ans_names;
+
+	PROTECT(ans = NEW_LIST(2));
+	PROTECT(ans_names = NEW_CHARACTER(2));
+	SET_STRING_ELT(ans_names, 0, mkChar("start"));
+	SET_STRING_ELT(ans_names, 1, mkChar("width"));
+	SET_NAMES(ans, ans_names);
+	SET_VECTOR_ELT(ans, 0, ans_start);
+	SET_VECTOR_ELT(ans, 1, ans_width);
+	UNPROTECT(2);
+	return ans;
+}
+
+
+/****************************************************************************
+ * restrict()
+ *
+ * Same 3 "drop ranges" modes as .restrict_IntegerRanges() at the R level:
+ *   0: ranges that are empty after restriction are dropped;
+ *   1: ranges that are not overlapping and not adjacent with the region of
+ *      restriction are dropped;
+ *   2: all ranges are kept.
+ */
+
+/* --- .Call ENTRY POINT ---
+ * 'breakpoints' must be NULL or the end of the partitioning of the
+ * CompressedRangesList object that 'x' (start and width) is the unlistData
+ * of.
+ * Returns a list with the following components:
+ *   start, width: The start and width of the ranges that are kept.
+ *   keep:         NULL if all the ranges are kept, otherwise the 1-based
+ *                 indices of the kept ranges.
+ *   breakpoints:  NULL if 'breakpoints' is NULL, otherwise the breakpoints
+ *                 of the partitioning of the kept ranges.
+ */
+SEXP C_restrict_ranges(SEXP x_start, SEXP x_width, SEXP start, SEXP end,
+		SEXP drop_ranges_mode, SEXP breakpoints)
+{
+	int x_len, start_len, end_len, mode, nbreakpoints, ans_len,
+	    i, j1, j2, k, s, e, rs, re, drop;
+	const int *x_start_p, *x_width_p, *start_p, *end_p, *breakpoints_p;
+	int *ans_start_p, *ans_width_p, *keep_p, *ans_breakpoints_p;
+	SEXP ans, ans_names, ans_start, ans_width, ans_keep, ans_breakpoints;
+
+	x_len = check_integer_pairs(x_start, x_width,
+				    &x_start_p, &x_width_p,
+				    "start(x)", "width(x)");
+	start_len = check_arg_length(start, x_len, "start");
+	end_len = check_arg_length(end, x_len, "end");
+	start_p = INTEGER(start);
+	end_p = INTEGER(end);
+	mode = INTEGER(drop_ranges_mode)[0];
+	if (breakpoints != R_NilValue) {
+		nbreakpoints = LENGTH(breakpoints);
+		breakpoints_p = INTEGER(breakpoints);
+		PROTECT(ans_breakpoints = NEW_INTEGER(nbreakpoints));
+		ans_breakpoints_p = INTEGER(ans_breakpoints);
+	} else {
+		nbreakpoints = 0;
+		breakpoints_p = ans_breakpoints_p = NULL;
+		PROTECT(ans_breakpoints = R_NilValue);
+	}
+
+	/* We allocate for the worst case (no range dropped) and shrink at
+	   the end. */
+	PROTECT(ans_start = NEW_INTEGER(x_len));
+	PROTECT(ans_width = NEW_INTEGER(x_len));
+	PROTECT(ans_keep = NEW_INTEGER(x_len));
+	ans_start_p = INTEGER(ans_start);
+	ans_width_p = INTEGER(ans_width);
+	keep_p = INTEGER(ans_keep);
+	ans_len = 0;
+	/* Leading empty list elements. */
+	for (k = 0; k < nbreakpoints && breakpoints_p[k] == 0; k++)
+		ans_breakpoints_p[k] = 0;
+	for (i = j1 = j2 = 0; i < x_len; i++) {
+		s = x_start_p[i];
+		e = s + x_width_p[i] - 1;
+		rs = start_p[j1];
+		re = end_p[j2];
+		NEXT_RECYCLED(j1, start_len);
+		NEXT_RECYCLED(j2, end_len);
+		drop = 0;
+		/* Compare with 'start'. */
+		if (rs != NA_INTEGER
+		 && (mode == 0 ? e < rs : e < rs - 1))
+		{
+			if (mode == 2)
+				e = rs - 1;
+			else
+				drop = 1;
+		}
+		if (!drop) {
+			if (rs != NA_INTEGER && s < rs)
+				s = rs;
+			/* Compare with 'end'. */
+			if (re != NA_INTEGER
+			 && (mode == 0 ? s > re :
+					 re != INT_MAX && s > re + 1))
+			{
+				if (mode == 2)
+					s = re + 1;
+				else
+					drop = 1;
+			}
+		}
+		if (!drop) {
+			if (re != NA_INTEGER && e > re)
+				e = re;
+			ans_start_p[ans_len] = s;
+			ans_width_p[ans_len] = e - s + 1;
+			keep_p[ans_len] = i + 1;
+			ans_len++;
+		}
+		if (breakpoints_p != NULL) {
+			while (k < nbreakpoints && breakpoints_p[k] == i + 1)
+				ans_breakpoints_p[k++] = ans_len;
+		}
+	}
+	if (breakpoints_p != NULL) {
+		/* Trailing empty list elements. */
+		while (k < nbreakpoints)
+			ans_breakpoints_p[k++] = ans_len;
+	}
+	if (ans_len != x_len) {
+		PROTECT(ans_start = lengthgets(ans_start, ans_len));
+		PROTECT(ans_width = lengthgets(ans_width, ans_len));
+		PROTECT(ans_keep = lengthgets(ans_keep, ans_len));
+	} else {
+		PROTECT(ans_start);
+		PROTECT(ans_width);
+		PROTECT(ans_keep = R_NilValue);
+	}
+
+	PROTECT(ans = NEW_LIST(4));
+	PROTECT(ans_names = NEW_CHARACTER(4));
+	SET_STRING_ELT(ans_names, 0, mkChar("start"));
+	SET_STRING_ELT(ans_names, 1, mkChar("width"));
+	SET_STRING_ELT(ans_names, 2, mkChar("keep"));
+	SET_STRING_ELT(ans_names, 3, mkChar("breakpoints"));
+	SET_NAMES(ans, ans_names);
+	SET_VECTOR_ELT(ans, 0, ans_start);
+	SET_VECTOR_ELT(ans, 1, ans_width);
+	SET_VECTOR_ELT(ans, 2, ans_keep);
+	SET_VECTOR_ELT(ans, 3, ans_breakpoints);
+	UNPROTECT(9);
+	return ans;
+}
+
+
+/****************************************************************************
+ * resize()
+ */
+
+#define FIX_START	1
+#define FIX_END		2
+#define FIX_CENTER	3
+
+/* --- .Call ENTRY POINT ---
+ * 'fix_lengths' and 'fix_codes' are the run lengths and run values of the
+ * 'fix' Rle (already recycled to the length of 'x'), with its run values
+ * encoded as FIX_START, FIX_END, or FIX_CENTER.
+ */
+SEXP C_resize_ranges(SEXP x_start, SEXP x_width, SEXP width,
+		SEXP fix_lengths, SEXP fix_codes)
+{
+	int x_len, width_len, nrun, i, j, r, run_end, w, fix, ovflow;
+	long long int shift;
+	const int *x_start_p, *x_width_p, *width_p, *fix_lengths_p,
+		  *fix_codes_p;
+	int *ans_start_p, *ans_width_p;
+	SEXP ans_start, ans_width, ans;
+
+	x_len = check_integer_pairs(x_start, x_width,
+				    &x_start_p, &x_width_p,
+				    "start(x)", "width(x)");
+	width_len = check_arg_length(width, x_len, "width");
+	width_p = INTEGER(width);
+	nrun = LENGTH(fix_lengths);
+	fix_lengths_p = INTEGER(fix_lengths);
+	fix_codes_p = INTEGER(fix_codes);
+	PROTECT(ans_start = NEW_INTEGER(x_len));
+	PROTECT(ans_width = NEW_INTEGER(x_len));
+	ans_start_p = INTEGER(ans_start);
+	ans_width_p = INTEGER(ans_width);
+	ovflow = 0;
+	for (r = i = j = 0; r < nrun; r++) {
+		fix = fix_codes_p[r];
+		for (run_end = i + fix_lengths_p[r]; i < run_end; i++) {
+			w = width_p[j];
+			NEXT_RECYCLED(j, width_len);
+			ans_width_p[i] = w;
+			switch (fix) {
+			    case FIX_END:
+				shift = (long long int) x_width_p[i] - w;
+				break;
+			    case FIX_CENTER:
+				shift = floor_half(
+					(long long int) x_width_p[i] - w);
+				break;
+			    default:
+				shift = 0;
+			}
+			ans_start_p[i] = as_int_or_NA(x_start_p[i] + shift,
+						      &ovflow);
+		}
+	}
+	if (i != x_len)
+		error("IRanges internal error in C_resize_ranges(): "
+		      "'fix' and 'x' have different lengths");
+	if (ovflow)
+		warning("NAs produced by integer overflow");
+	ans = new_start_width_list(ans_start, ans_width);
+	UNPROTECT(2);
+	return ans;
+}
+
+
+/****************************************************************************
+ * flank()
+ */
+
+/* --- .Call ENTRY POINT --- */
+SEXP C_flank_ranges(SEXP x_start, SEXP x_width, SEXP width, SEXP start,
+		SEXP both)
+{
+	int x_len, width_len, start_len, both0, i, j1, j2, w, from_start,
+	    ovflow;
+	long long int s, e, ans_s, ans_w;
+	const int *x_start_p, *x_width_p, *width_p, *start_p;
+	int *ans_start_p, *ans_width_p;
+	SEXP ans_start, ans_width, ans;
+
+	x_len = check_integer_pairs(x_start, x_width,
+				    &x_start_p, &x_width_p,
+				    "start(x)", "width(x)");
+	width_len = check_arg_length(width, x_len, "width");
+	start_len = check_arg_length(start, x_len, "start");
+	width_p = INTEGER(width);
+	start_p = LOGICAL(start);
+	both0 = LOGICAL(both)[0];
+	PROTECT(ans_start = NEW_INTEGER(x_len));
+	PROTECT(ans_width = NEW_INTEGER(x_len));
+	ans_start_p = INTEGER(ans_start);
+	ans_width_p = INTEGER(ans_width);
+	ovflow = 0;
+	for (i = j1 = j2 = 0; i < x_len; i++) {
+		w = width_p[j1];
+		from_start = start_p[j2];
+		NEXT_RECYCLED(j1, width_len);
+		NEXT_RECYCLED(j2, start_len);
+		if (w == NA_INTEGER) {
+			ans_start_p[i] = ans_width_p[i] = NA_INTEGER;
+			continue;
+		}
+		s = x_start_p[i];
+		e = s + x_width_p[i] - 1;
+		if (both0) {
+			if (w < 0)
+				w = -w;
+			ans_w = 2LL * w;
+			ans_s = from_start ? s - w : e - w + 1;
+		} else if (w >= 0) {
+			ans_w = w;
+			ans_s = from_start ? s - w : e + 1;
+		} else {
+			ans_w = -w;
+			ans_s = from_start ? s : e + w + 1;
+		}
+		ans_start_p[i] = as_int_or_NA(ans_s, &ovflow);
+		ans_width_p[i] = as_int_or_NA(ans_w, &ovflow);
+	}
+	if (ovflow)
+		warning("NAs produced by integer overflow");
+	ans = new_start_width_list(ans_start, ans_width);
+	UNPROTECT(2);
+	return ans;
+}
+
+
+/****************************************************************************
+ * promoters()
+ */
+
+/* --- .Call ENTRY POINT ---
+ * 'upstream' and 'downstream' must be NA-free and >= 0.
+ */
+SEXP C_promoters_ranges(SEXP x_start, SEXP x_width, SEXP upstream,
+		SEXP downstream)
+{
+	int x_len, upstream_len, downstream_len, i, j1, j2, up, down, ovflow;
+	const int *x_start_p, *x_width_p, *upstream_p, *downstream_p;
+	int *ans_start_p, *ans_width_p;
+	SEXP ans_start, ans_width, ans;
+
+	x_len = check_integer_pairs(x_start, x_width,
+				    &x_start_p, &x_width_p,
+				    "start(x)", "width(x)");
+	upstream_len = check_arg_length(upstream, x_len, "upstream");
+	downstream_len = check_arg_length(downstream, x_len, "downstream");
+	upstream_p = INTEGER(upstream);
+	downstream_p = INTEGER(downstream);
+	PROTECT(ans_start = NEW_INTEGER(x_len));
+	PROTECT(ans_width = NEW_INTEGER(x_len));
+	ans_start_p = INTEGER(ans_start);
+	ans_width_p = INTEGER(ans_width);
+	ovflow = 0;
+	for (i = j1 = j2 = 0; i < x_len; i++) {
+		up = upstream_p[j1];
+		down = downstream_p[j2];
+		NEXT_RECYCLED(j1, upstream_len);
+		NEXT_RECYCLED(j2, downstream_len);
+		ans_start_p[i] = as_int_or_NA(
+				(long long int) x_start_p[i] - up, &ovflow);
+		ans_width_p[i] = as_int_or_NA(
+				(long long int) up + down, &ovflow);
+	}
+	if (ovflow)
+		warning("NAs produced by integer overflow");
+	ans = new_start_width_list(ans_start, ans_width);
+	UNPROTECT(2);
+	return ans;
+}
+
@@ -0,0 +1,329 @@
+/****************************************************************************
+ *                   Slicing an Rle object on its values                    *
+ ****************************************************************************/
+#include "IRanges.h"
+#include "S4Vectors_interface.h"
+
+#include <R_ext/Arith.h>
+#include <limits.h>
+
+#define R_INT_MIN	(1+INT_MIN)
+
+
+/****************************************************************************
+ * C_slice_Rle()
+ *
+ * Scan the runs of an integer, logical, or numeric Rle once against the
+ * bounds and emit the slices directly (adjacent runs that are within the
+ * bounds are coalesced). This avoids the 2 logical Rles (and the 3rd one
+ * returned by '&') that the R level used to compute before coercing to
+ * IRanges. The max and the sum of the values in each slice can optionally
+ * be computed in the same pass.
+ */
+
+static int value_is_in_slice(double v, double lower, double upper,
+		int include_lower, int include_upper)
+{
+	if (lower != R_NegInf) {
+		if (include_lower ? v < lower : v <= lower)
+			return 0;
+	}
+	if (upper != R_PosInf) {
+		if (include_upper ? v > upper : v >= upper)
+			return 0;
+	}
+	return 1;
+}
+
+/* Store the max and sum of a slice. 'has_na' is 1 if the slice contains NAs
+   (only possible when both bounds are infinite). */
+static void append_slice_summaries(DoubleAE *max_buf, DoubleAE *sum_buf,
+		int has_na, double max, double sum, int is_int)
+{
+	if (has_na) {
+		max = NA_REAL;
+		sum = NA_REAL;
+	} else if (is_int && (sum > INT_MAX || sum < R_INT_MIN)) {
+		error("Integer overflow");
+	}
+	DoubleAE_insert_at(max_buf, DoubleAE_get_nelt(max_buf), max);
+	DoubleAE_insert_at(sum_buf, DoubleAE_get_nelt(sum_buf), sum);
+	return;
+}
+
+static SEXP new_summary_from_DoubleAE(const DoubleAE *buf, int is_int)
+{
+	SEXP ans;
+	int n, i;
+	double v;
+
+	if (!is_int)
+		return new_NUMERIC_from_DoubleAE(buf);
+	n = DoubleAE_get_nelt(buf);
+	PROTECT(ans = NEW_INTEGER(n));
+	for (i = 0; i < n; i++) {
+		v = buf->elts[i];
+		INTEGER(ans)[i] = ISNAN(v) ? NA_INTEGER : (int) v;
+	}
+	UNPROTECT(1);
+	return ans;
+}
+
+/* --- .Call ENTRY POINT ---
+ * Returns 'list(start, width, max, sum)'. 'max' and 'sum' are NULL unless
+ * 'with_summaries' is TRUE.
+ */
+SEXP C_slice_Rle(SEXP x, SEXP lower, SEXP upper,
+		SEXP includeLower, SEXP includeUpper, SEXP with_summaries)
+{
+	SEXP values, lengths, ans, ans_names, ans_elt;
+	int nrun, is_int, include_lower, include_upper, summarize, keep_all,
+	    k, in_slice, has_na, len, iv;
+	double lower0, upper0, v, max, sum;
+	long long int pos, slice_start;
+	IntAE *start_buf, *width_buf;
+	DoubleAE *max_buf, *sum_buf;
+
+	values = GET_SLOT(x, install("values"));
+	lengths = GET_SLOT(x, install("lengths"));
+	switch (TYPEOF(values)) {
+	    case LGLSXP: case INTSXP: is_int = 1; break;
+	    case REALSXP: is_int = 0; break;
+	    default:
+		error("Rle must contain either 'integer', 'logical', "
+		      "or 'numeric' values");
+	}
+	lower0 = REAL(lower)[0];
+	upper0 = REAL(upper)[0];
+	include_lower = LOGICAL(includeLower)[0];
+	include_upper = LOGICAL(includeUpper)[0];
+	summarize = LOGICAL(with_summaries)[0];
+	/* Like at the R level, NAs are in the slices when both bounds are
+	   infinite. Otherwise they are an error. */
+	keep_all = lower0 == R_NegInf && upper0 == R_PosInf;
+
+	nrun = LENGTH(lengths);
+	start_buf = new_IntAE(0, 0, 0);
+	width_buf = new_IntAE(0, 0, 0);
+	max_buf = new_DoubleAE(0, 0, 0);
+	sum_buf = new_DoubleAE(0, 0, 0);
+	pos = 1;
+	slice_start = 0;  /* 0 means no open slice */
+	has_na = 0;
+	max = sum = 0.0;
+	for (k = 0; k < nrun; k++) {
+		len = INTEGER(lengths)[k];
+		if (is_int) {
+			iv = INTEGER(values)[k];
+			v = iv == NA_INTEGER ? NA_REAL : (double) iv;
+		} else {
+			v = REAL(values)[k];
+		}
+		if (ISNAN(v)) {
+			if (!keep_all)
+				error("cannot coerce a non-logical 'Rle' or a "
+				      "logical 'Rle' with NAs to an IRanges "
+				      "object");
+			in_slice = 1;
+		} else {
+			in_slice = keep_all || value_is_in_slice(v,
+						lower0, upper0,
+						include_lower, include_upper);
+		}
+		if (in_slice) {
+			if (slice_start == 0) {
+				slice_start = pos;
+				has_na = 0;
+				max = R_NegInf;
+				sum = 0.0;
+			}
+			if (ISNAN(v)) {
+				has_na = 1;
+			} else {
+				if (v > max)
+					max = v;
+				sum += v * len;
+			}
+		} else if (slice_start != 0) {
+			IntAE_insert_at(start_buf, IntAE_get_nelt(start_buf),
+					(int) slice_start);
+			IntAE_insert_at(width_buf, IntAE_get_nelt(width_buf),
+					(int) (pos - slice_start));
+			if (summarize)
+				append_slice_summaries(max_buf, sum_buf,
+						has_na, max, sum, is_int);
+			slice_start = 0;
+		}
+		pos += len;
+	}
+	if (slice_start != 0) {
+		IntAE_insert_at(start_buf, IntAE_get_nelt(start_buf),
+				(int) slice_start);
+		IntAE_insert_at(width_buf, IntAE_get_nelt(width_buf),
+				(int) (pos - slice_start));
+		if (summarize)
+			append_slice_summaries(max_buf, sum_buf,
+					has_na, max, sum, is_int);
+	}
+
+	PROTECT(ans = NEW_LIST(4));
+	PROTECT(ans_names = NEW_CHARACTER(4));
+	SET_STRING_ELT(ans_names, 0, mkChar("start"));
+	SET_STRING_ELT(ans_names, 1, mkChar("width"));
+	SET_STRING_ELT(ans_names, 2, mkChar("max"));
+	SET_STRING_ELT(ans_names, 3, mkChar("sum"));
+	SET_NAMES(ans, ans_names);
+	UNPROTECT(1);
+	PROTECT(ans_elt = new_INTEGER_from_IntAE(start_buf));
+	SET_VECTOR_ELT(ans, 0, ans_elt);
+	UNPROTECT(1);
+	PROTECT(ans_elt = new_INTEGER_from_IntAE(width_buf));
+	SET_VECTOR_ELT(ans, 1, ans_elt);
+	UNPROTECT(1);
+	if (summarize) {
+		PROTECT(ans_elt = new_summary_from_DoubleAE(max_buf, is_int));
+		SET_VECTOR_ELT(ans, 2, ans_elt);
+		UNPROTECT(1);
+		PROTECT(ans_elt = new_summary_from_DoubleAE(sum_buf, is_int));
+		SET_VECTOR_ELT(ans, 3, ans_elt);
+		UNPROTECT(1);
+	}
+	UNPROTECT(1);
+	return ans;
+}
+
+
+/****************************************************************************
+ * C_multislice_Rle()
+ *
+ * Slice an Rle at several increasing thresholds in a single pass over its
+ * runs. Because the thresholds are sorted, the levels that a run value
+ * passes always form a prefix of them, so the slices that are currently
+ * open form a stack: when the value goes up, new slices are opened at the
+ * levels above the current top of the stack (each one is contained in the
+ * open slice of the level below, which is its parent), and when it goes
+ * down, the slices above the new top are closed.
+ */
+
+/* Number of thresholds that 'v' passes. */
+static int nb_levels_passed(double v, const double *thresholds, int nlevel,
+		int include_lower)
+{
+	int lo, hi, mid;
+
+	/* Binary search for the 1st threshold that 'v' doesn't pass. */
+	lo = 0;
+	hi = nlevel;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (include_lower ? v >= thresholds[mid] : v > thresholds[mid])
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/* --- .Call ENTRY POINT ---
+ * 'thresholds': a numeric vector sorted in strictly increasing order.
+ * Returns 'list(start, width, parent)' where each element is a list with
+ * one integer vector per threshold. 'parent' contains the 1-based index of
+ * the slice at the previous threshold that contains each slice (NA for
+ * the slices at the 1st threshold).
+ */
+SEXP C_multislice_Rle(SEXP x, SEXP thresholds, SEXP includeLower)
+{
+	SEXP values, lengths, ans, ans_names, ans_elt;
+	int nrun, nlevel, is_int, include_lower, k, j, top, new_top, len, iv,
+	    slice_idx, parent;
+	const double *thresholds_p;
+	double v;
+	long long int pos;
+	IntAEAE *start_bufs, *width_bufs, *parent_bufs;
+	IntAE *start_buf;
+
+	values = GET_SLOT(x, install("values"));
+	lengths = GET_SLOT(x, install("lengths"));
+	switch (TYPEOF(values)) {
+	    case LGLSXP: case INTSXP: is_int = 1; break;
+	    case REALSXP: is_int = 0; break;
+	    default:
+		error("Rle must contain either 'integer', 'logical', "
+		      "or 'numeric' values");
+	}
+	nlevel = LENGTH(thresholds);
+	thresholds_p = REAL(thresholds);
+	for (j = 1; j < nlevel; j++)
+		if (thresholds_p[j] <= thresholds_p[j - 1])
+			error("'thresholds' must be sorted in strictly "
+			      "increasing order");
+	include_lower = LOGICAL(includeLower)[0];
+
+	start_bufs = new_IntAEAE(nlevel, nlevel);
+	width_bufs = new_IntAEAE(nlevel, nlevel);
+	parent_bufs = new_IntAEAE(nlevel, nlevel);
+	nrun = LENGTH(lengths);
+	pos = 1;
+	top = 0;  /* nb of levels with an open slice */
+	for (k = 0; k <= nrun; k++) {
+		if (k == nrun) {
+			/* Close all the open slices. */
+			new_top = 0;
+		} else {
+			if (is_int) {
+				iv = INTEGER(values)[k];
+				v = iv == NA_INTEGER ? NA_REAL : (double) iv;
+			} else {
+				v = REAL(values)[k];
+			}
+			if (ISNAN(v))
+				error("'x' contains NAs");
+			new_top = nb_levels_passed(v, thresholds_p, nlevel,
+						   include_lower);
+		}
+		for (j = new_top; j < top; j++) {
+			/* Close the open slice at level 'j'. It's always the
+			   last slice at its level. */
+			start_buf = start_bufs->elts[j];
+			slice_idx = IntAE_get_nelt(start_buf) - 1;
+			width_bufs->elts[j]->elts[slice_idx] =
+				(int) (pos - start_buf->elts[slice_idx]);
+		}
+		for (j = top; j < new_top; j++) {
+			/* Open a new slice at level 'j'. Its parent is the
+			   open slice at level 'j - 1'. */
+			parent = j == 0 ? NA_INTEGER :
+				 (int) IntAE_get_nelt(start_bufs->elts[j - 1]);
+			IntAE_insert_at(start_bufs->elts[j],
+				IntAE_get_nelt(start_bufs->elts[j]), (int) pos);
+			IntAE_insert_at(width_bufs->elts[j],
+				IntAE_get_nelt(width_bufs->elts[j]), 0);
+			IntAE_insert_at(parent_bufs->elts[j],
+				IntAE_get_nelt(parent_bufs->elts[j]), parent);
+		}
+		top = new_top;
+		if (k < nrun) {
+			len = INTEGER(lengths)[k];
+			pos += len;
+		}
+	}
+
+	PROTECT(ans = NEW_LIST(3));
+	PROTECT(ans_names = NEW_CHARACTER(3));
+	SET_STRING_ELT(ans_names, 0, mkChar("start"));
+	SET_STRING_ELT(ans_names, 1, mkChar("width"));
+	SET_STRING_ELT(ans_names, 2, mkChar("parent"));
+	SET_NAMES(ans, ans_names);
+	UNPROTECT(1);
+	PROTECT(ans_elt = new_LIST_from_IntAEAE(start_bufs, 0));
+	SET_VECTOR_ELT(ans, 0, ans_elt);
+	UNPROTECT(1);
+	PROTECT(ans_elt = new_LIST_from_IntAEAE(width_bufs, 0));
+	SET_VECTOR_ELT(ans, 1, ans_elt);
+	UNPROTECT(1);
+	PROTECT(ans_elt = new_LIST_from_IntAEAE(parent_bufs, 0));
+	SET_VECTOR_ELT(ans, 2, ans_elt);
+	UNPROTECT(1);
+	UNPROTECT(1);
+	return ans;
+}